@@ -1,5 +1,6 @@
 #include <gl/global.hpp>
 #include <gl/buffer.hpp>
+#include <gl/buffer_pool.hpp>
 #include <gl/shader.hpp>
 #include <gl/vertex_array.hpp>
 #include <gl/texture.hpp>
@@ -7,186 +8,803 @@
 #include <gl/aabb.hpp>
 #include <gl/framebuffer.hpp>
 #include <gl/scene.hpp>
+#include <gl/thread_pool.hpp>
+#include <gl/timer.hpp>
 #include <memory>
 #include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
 
 using namespace std;
 using namespace glm;
 using namespace GL;
 using namespace Util;
 
-class Scene
+// Builds the box shader as one program with DIFFUSE_MAP and LOD read from a
+// uniform, instead of one program per value. See the draw timings in the log.
+#ifdef UBER_SHADER
+static const bool uber_shader = true;
+#else
+static const bool uber_shader = false;
+#endif
+
+// Stores blocks in 20 bytes instead of 32: the center as 3 floats, the
+// radius taken from the cull grid and the velocity as half floats.
+#ifdef COMPACT_BLOCKS
+static const bool compact_blocks = true;
+#else
+static const bool compact_blocks = false;
+#endif
+
+// LOD policy, finest level first. Blocks are drawn with the first level their
+// projected radius in pixels reaches, the last level takes the rest. Instance
+// lists, draw commands and the cull shader's table are all set up from this.
+struct LodDesc
 {
-   public:
-      void init()
-      {
-         int base = 48;
-         int scale = 8;
-         for (int z = -base; z < base; z++)
-            for (int y = -base; y < base; y++)
-               for (int x = -base; x < base; x++)
-               {
-                  blocks.push_back(vec4(vec3(x, y, z) * vec3(scale), 1.4143f));
-                  blocks.push_back(vec4(0.0f));
-               }
-         size = 2 * base / 4;
-
-         model.init(GL_ARRAY_BUFFER, blocks.size() * sizeof(vec4), Buffer::None, blocks.data());
-
-         auto mesh = create_mesh_box();
-         auto mesh_fine = load_meshes_obj("app/mesh.obj");
-
-         mesh_fine[0].arrays.push_back({3, 4, GL_FLOAT, GL_FALSE, 0, 1, 1, 0});
-         render_array[0].setup(mesh_fine[0].arrays, { &vert_fine, &culled_buffer[0] }, &elem_fine);
+   int mesh; // Level of the generated LOD chain, or point_sprites.
+   float min_size; // Projected radius in pixels.
+};
 
-         mesh.arrays.push_back({3, 4, GL_FLOAT, GL_FALSE, 0, 1, 1, 0});
-         render_array[1].setup(mesh.arrays, { &vert, &culled_buffer[1] }, &elem);
+static const int point_sprites = -1;
+static const LodDesc lod_table[] = {
+   { 0, 6.146f }, // Source mesh, up to a depth of 100 at 640x360.
+   { 1, 1.229f }, // Generated mesh, up to 500.
+   { point_sprites, 0.0f },
+};
 
-         // Point sprites here.
-         VertexArray::Array point_array = { Shader::VertexLocation, 4, GL_FLOAT, GL_FALSE };
-         render_array[2].setup({point_array}, { &culled_buffer[2] }, nullptr);
+// Length of the LOD chain needed to cover every mesh level in lod_table.
+// Every level up to it is generated, so the table should skip none.
+static unsigned lod_chain_levels()
+{
+   int coarsest = 0;
+   for (auto& desc : lod_table)
+      coarsest = std::max(coarsest, desc.mesh);
+   return coarsest + 1;
+}
 
-         vert_fine.init(GL_ARRAY_BUFFER, mesh_fine[0].vbo, Buffer::None);
-         elem_fine.init(GL_ELEMENT_ARRAY_BUFFER, mesh_fine[0].ibo, Buffer::None);
-         vert.init(GL_ARRAY_BUFFER, mesh.vbo, Buffer::None);
-         elem.init(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo, Buffer::None);
+class Scene : public ContextListener
+{
+   public:
+      Scene() { ContextListener::init(); }
+      ~Scene() { deinit(); }
 
-         indices_fine = mesh_fine[0].ibo.size();
-         indices = mesh.ibo.size();
+      // The back buffer may be replaced along with the context or the viewport,
+      // its sample count is queried again on the next frame. The depth pyramid
+      // comes back with undefined contents, so the first cull pass can't use it.
+      void reset() override
+      {
+         sample_buffers = -1;
+         pyramid_valid = false;
+      }
 
-         MaterialBuffer material_buf(mesh_fine[0].material);
-         material[0].init(GL_UNIFORM_BUFFER, sizeof(material),
-               Buffer::None, &material_buf, Shader::Material);
+      void destroyed() override {}
+      void viewport_changed() { sample_buffers = -1; }
 
-         mesh.material.diffuse = vec3(0.5f, 0.8f, 0.5f);
-         mesh.material.ambient = vec3(0.5f, 0.8f, 0.5f);
-         material_buf = mesh.material;
-         material[1].init(GL_UNIFORM_BUFFER, sizeof(material),
-               Buffer::None, &material_buf, Shader::Material);
+      void init()
+      {
+         // Mesh processing runs on the thread pool while the rest of the scene is set up.
+         auto lods_future = ThreadPool::get().submit([] {
+            // Level 0 is the source mesh, each further level has a quarter of its triangles.
+            LodMeshes lods;
+            lods.meshes = generate_lod_chain(load_meshes_obj("app/mesh.obj")[0],
+                  lod_chain_levels(), 0.25f, 0.1f);
+            for (auto& lod : lods.meshes)
+               optimize_mesh(lod);
+            // Clusters index the final ibo, so they are built before it is packed.
+            lods.meshlets = build_meshlets(lods.meshes.front());
+            for (auto& lod : lods.meshes)
+               lod.finalize(Mesh::QuantizeAll);
+            return lods;
+         });
+
+         // Block layout is fixed at build time, only one value of COMPACT_BLOCKS is compiled.
+         for (auto shader : { &physics_shader, &bin_shader, &cull_shader })
+            shader->set_define(shader->reserve_define("COMPACT_BLOCKS", 1), compact_blocks);
+         physics_shader.init_compute("app/shaders/boxphysics.cs");
+         bin_shader.init_compute("app/shaders/boxbin.cs");
+         cells_shader.init_compute("app/shaders/boxcells.cs");
+         retest_define = cull_shader.reserve_define("RETEST", 1);
+         // Subgroup ballots speed up compaction of the surviving blocks where available.
+         // The KHR path needs ballots in compute shaders, which the extension alone doesn't promise.
+         cull_shader.enable_extension("GL_KHR_shader_subgroup_ballot", [](const Capabilities& caps) {
+            return (caps.subgroup_stages & GL_COMPUTE_SHADER_BIT) &&
+               (caps.subgroup_features & GL_SUBGROUP_FEATURE_BALLOT_BIT_KHR);
+         });
+         cull_shader.enable_extension("GL_ARB_shader_ballot");
+         cull_shader.enable_extension("GL_ARB_gpu_shader_int64");
+         cull_shader.init_compute("app/shaders/boxcull.cs");
+         from_depth_define = hiz_shader.reserve_define("FROM_DEPTH", 1);
+         hiz_shader.init_compute("app/shaders/hiz.cs");
+         auto define_mode = uber_shader ? Shader::Dynamic : Shader::Permuted;
+         diffuse_map_define = render_shader.reserve_define("DIFFUSE_MAP", 1, define_mode);
+         lod_define = render_shader.reserve_define("LOD", 1, define_mode);
+         render_shader.init("app/shaders/boxrender.vs", "app/shaders/boxrender.fs");
+         render_shader_point.init("app/shaders/boxrender_point.vs", "app/shaders/boxrender_point.fs");
 
-         material_buf = mesh.material;
-         material[2].init(GL_UNIFORM_BUFFER, sizeof(material),
-               Buffer::None, &material_buf, Shader::Material);
+         // Compile every permutation at context reset, overlapping with the uploads.
+         physics_shader.precompile({ Shader::Permutation() });
+         bin_shader.precompile({ Shader::Permutation() });
+         cells_shader.precompile();
+         cull_shader.precompile({{{"RETEST", 0}}, {{"RETEST", 1}}});
+         hiz_shader.precompile();
+         render_shader.precompile();
+         render_shader_point.precompile();
+
+         // Instance data is cheap to recompute, so it is generated straight into
+         // the buffer on every context reset instead of being kept around.
+         const int base = grid_base;
+         const int scale = grid_spacing;
+         size = 2 * base / 4;
+         num_blocks = 8 * base * base * base;
+         positions.init_generated(GL_ARRAY_BUFFER, num_blocks * (compact_blocks ? sizeof(vec3) : sizeof(vec4)), Buffer::None,
+               [](void *data, GLsizei) {
+                  generate_positions(data, compact_blocks);
+               });
+         velocities.init_generated(GL_ARRAY_BUFFER, num_blocks * (compact_blocks ? 2 * sizeof(GLuint) : sizeof(vec4)), Buffer::None,
+               [](void *data, GLsizei size) {
+                  memset(data, 0, size);
+               });
+         simulation_buffer.init(GL_UNIFORM_BUFFER, sizeof(Simulation), Buffer::Stream, nullptr, 6);
+         physics_time = 0.0;
+
+         // Blocks are binned into cells of 8x8x8 initial positions, so a
+         // cell can take in twice its share before spilling into the overflow list.
+         CullGrid grid;
+         grid.origin = vec4(vec3(-base * scale), 8 * scale);
+         grid.dims = uvec4(uvec3(2 * base / 8), 2 * 8 * 8 * 8);
+         grid.radius = block_radius;
+         cull_grid = uniform_pool.allocate(sizeof(grid), &grid);
+
+         num_cells = grid.dims.x * grid.dims.y * grid.dims.z;
+         cell_counts = grid_pool.allocate((num_cells + 1) * sizeof(GLuint));
+         cell_members = grid_pool.allocate((num_cells * grid.dims.w + num_blocks) * sizeof(GLuint));
+         cell_chunks = grid_pool.allocate((num_cells * (grid.dims.w / chunk_size) + (num_blocks + chunk_size - 1) / chunk_size) * sizeof(GLuint));
+
+         // Cell chunks for the first cull pass, then hidden blocks for the second, see boxcull.cs.
+         const GLuint dispatch_args[8] = { 0, 1, 1, 0, 0, 1, 1, 0 };
+         cull_dispatch.init(GL_DISPATCH_INDIRECT_BUFFER, sizeof(dispatch_args), Buffer::Copy, dispatch_args);
+         retest_list = grid_pool.allocate(num_blocks * sizeof(GLuint));
+
+         occlusion_buffer.init(GL_UNIFORM_BUFFER, sizeof(Occlusion), Buffer::Stream, nullptr, 5);
+
+         auto lod_meshes = lods_future.get();
+         auto& meshes = lod_meshes.meshes;
+         meshlets = upload_meshlets(grid_pool, lod_meshes.meshlets);
+         num_meshlets = lod_meshes.meshlets.size();
+         Log::log("LOD 0: %u meshlets.", num_meshlets);
+
+         auto point_material = create_mesh_box().material;
+         point_material.diffuse = vec3(0.5f, 0.8f, 0.5f);
+         point_material.ambient = vec3(0.5f, 0.8f, 0.5f);
+
+         // Every level has a list that fits all blocks, all lists share one buffer.
+         // LOD meshes and uniforms share another buffer each.
+         num_lods = sizeof(lod_table) / sizeof(lod_table[0]);
+         GLsizeiptr list_size = num_blocks * sizeof(vec4);
+         culled_lists.init(GL_SHADER_STORAGE_BUFFER, num_lods * list_size, Buffer::Copy);
+
+         LodTableBuffer table = {};
+         table.num_lods = num_lods;
+         pass_words = table.pass_words = num_lods * sizeof(IndirectCommand) / sizeof(GLuint);
+         vector<IndirectCommand> pass_commands(num_lods);
+
+         for (unsigned i = 0; i < num_lods; i++)
+         {
+            auto& desc = lod_table[i];
+            auto& lod = lods[i];
+            auto& level = table.levels[i];
+            GLuint command_word = i * sizeof(IndirectCommand) / sizeof(GLuint);
+
+            lod.points = desc.mesh == point_sprites;
+            lod.culled.buffer = &culled_lists;
+            lod.culled.offset = i * list_size;
+            lod.culled.size = list_size;
+            level.min_size = desc.min_size;
+            level.list_offset = i * num_blocks;
+
+            if (lod.points)
+            {
+               // Drawn with glDrawArraysIndirect, see IndirectCommand.
+               pass_commands[i] = { 0, 1 };
+               lod.count_word = command_word + offsetof(IndirectCommand, count) / sizeof(GLuint);
+               level.first_word = command_word + offsetof(IndirectCommand, firstIndex) / sizeof(GLuint);
+
+               VertexArray::Array point_array = { Shader::VertexLocation, 4, GL_FLOAT, GL_FALSE };
+               lod.array.setup({point_array}, { lod.culled });
+
+               MaterialBuffer material_buf(point_material);
+               lod.material = uniform_pool.allocate(sizeof(material_buf), &material_buf);
+            }
+            else
+            {
+               // The chain stops early if simplification doesn't get anywhere.
+               auto& mesh = meshes[std::min(size_t(desc.mesh), meshes.size() - 1)];
+               mesh.init_buffers(mesh_pool, lod.vert, lod.elem);
+               auto arrays = mesh.arrays;
+               arrays.push_back({3, 4, GL_FLOAT, GL_FALSE, 0, 1, 1, 0});
+               lod.array.setup(arrays, { lod.vert, lod.culled }, lod.elem);
+               lod.index_type = mesh.index_type;
+
+               pass_commands[i] = { GLuint(mesh.ibo.size()), 0, lod.elem.first_element(mesh.index_size()) };
+               lod.count_word = command_word + offsetof(IndirectCommand, primCount) / sizeof(GLuint);
+               level.first_word = command_word + offsetof(IndirectCommand, baseInstance) / sizeof(GLuint);
+
+               // Dequantizes positions in the vertex shader.
+               mat4 position_transform = mesh.position_transform();
+               lod.transform = uniform_pool.allocate(sizeof(position_transform), value_ptr(position_transform));
+
+               MaterialBuffer material_buf(mesh.material);
+               lod.material = uniform_pool.allocate(sizeof(material_buf), &material_buf);
+            }
+            level.count_word = lod.count_word;
+         }
+         lod_buffer = uniform_pool.allocate(sizeof(table), &table);
+
+         // One set of draw commands per frame in flight, each with commands
+         // for both cull passes. Only the counters written by the cull shader
+         // change, they are cleared on the GPU. Sets are also bound as storage,
+         // 256 is the largest storage buffer offset alignment GL allows.
+         GLsizeiptr pass_size = num_lods * sizeof(IndirectCommand);
+         commands_stride = (2 * pass_size + 255) & ~GLsizeiptr(255);
+         vector<uint8_t> commands(2 * commands_stride);
+         for (unsigned i = 0; i < 2; i++)
+            for (unsigned pass = 0; pass < 2; pass++)
+               memcpy(commands.data() + i * commands_stride + pass * pass_size, pass_commands.data(), pass_size);
+         indirect.init(GL_DRAW_INDIRECT_BUFFER, commands.size(), Buffer::Copy, commands.data());
 
-         if (!mesh.material.diffuse_map.empty())
+         auto& material = meshes.front().material;
+         if (!material.diffuse_map.empty())
          {
             use_diffuse = true;
             tex.load_texture({Texture::Texture2D,
-                  { mesh.material.diffuse_map },
+                  { material.diffuse_map },
                   true });
          }
          else
             use_diffuse = false;
+      }
 
-         cull_shader.init_compute("app/shaders/boxcull.cs");
-         render_shader.reserve_define("DIFFUSE_MAP", 1);
-         render_shader.reserve_define("LOD", 1);
-         render_shader.init("app/shaders/boxrender.vs", "app/shaders/boxrender.fs");
-         render_shader_point.init("app/shaders/boxrender_point.vs", "app/shaders/boxrender_point.fs");
+      // Polls every scene program, frames skip the scene until all are linked
+      // instead of blocking on the compiler in use().
+      bool ready()
+      {
+         bool done = true;
+         for (auto shader : { &physics_shader, &bin_shader, &cells_shader, &cull_shader,
+                  &hiz_shader, &render_shader, &render_shader_point })
+            done = shader->ready() && done;
+         return done;
+      }
+
+      // Advances the blocks by the whole steps that fit in the time passed so far.
+      // Needs the global vertex data bound, the blocks are pushed away from the camera.
+      void simulate(float delta)
+      {
+#ifdef CHECK_COMPACT_BLOCKS
+         if (!layouts_checked)
+         {
+            check_block_layouts(CHECK_COMPACT_BLOCKS);
+            layouts_checked = true;
+         }
+#endif
 
-         for (auto& buffer : culled_buffer)
-            buffer.init(GL_ARRAY_BUFFER, 16 * 1024 * 1024, Buffer::Copy);
+         physics_time += delta;
+         unsigned steps = unsigned(physics_time / physics_step);
+         if (steps > max_physics_steps)
+         {
+            steps = max_physics_steps;
+            physics_time = steps * physics_step;
+         }
+         if (!steps)
+            return;
+         physics_time -= steps * physics_step;
+
+         Simulation *simulation;
+         if (simulation_buffer.map(simulation))
+         {
+            simulation->step = physics_step;
+            simulation->steps = steps;
+            simulation->num_blocks = num_blocks;
+            simulation_buffer.unmap();
+         }
+
+         physics_shader.use();
+         simulation_buffer.bind();
+         positions.bind_indexed(GL_SHADER_STORAGE_BUFFER, 0);
+         velocities.bind_indexed(GL_SHADER_STORAGE_BUFFER, 1);
+         glDispatchCompute((num_blocks + 63) / 64, 1, 1);
+         glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
       }
 
-      void render(const mat4& view_proj)
+      void render(const mat4& view_proj, unsigned width, unsigned height)
       {
-         // Reset indirect draw buffer.
-         struct IndirectCommand
+         // Depth can't be copied out of a multisampled framebuffer, occlusion culling is off then.
+         if (sample_buffers < 0)
+            glGetIntegerv(GL_SAMPLE_BUFFERS, &sample_buffers);
+         bool occlusion = sample_buffers == 0;
+         if (!occlusion || width != pyramid_width || height != pyramid_height)
+            pyramid_valid = false;
+
+         Occlusion occlusion_data;
+         occlusion_data.previous_vp = pyramid_vp;
+         occlusion_data.previous_valid = pyramid_valid;
+         Occlusion *occlusion_buf;
+         if (occlusion_buffer.map(occlusion_buf))
          {
-            GLuint count;
-            GLuint primCount;
-            GLuint firstIndex;
-            GLuint baseVertex;
-            GLuint baseInstance;
-         };
-         IndirectCommand command[] = {
-            { GLuint(indices_fine) }, // primCount is incremented by shaders.
-            { GLuint(indices) },
-            { 0, 1 }, // Draw point sprites here, so we're using glDrawArraysIndirect.
-         };
-         indirect.init(GL_DRAW_INDIRECT_BUFFER, sizeof(command), Buffer::Copy, command);
-
-         // Frustum cull instanced cubes (points) and update indirect draw buffer.
+            *occlusion_buf = occlusion_data;
+            occlusion_buffer.unmap();
+         }
+
+         if (frame_count == 3 || (frame_count && frame_count % 600 == 0))
+            log_timings();
+         draw_cpu_frames++;
+
+         // Reset the counters of this frame's draw commands. The other set may
+         // still be in use by the previous frame's draws.
+         GLintptr commands_offset = (frame_count++ & 1) * commands_stride;
+         for (unsigned pass = 0; pass < 2; pass++)
+            for (unsigned i = 0; i < num_lods; i++)
+               indirect.clear(commands_offset + (pass * pass_words + lods[i].count_word) * sizeof(GLuint), sizeof(GLuint));
+
+         cell_counts.buffer->clear(cell_counts.offset, cell_counts.size);
+         cull_dispatch.clear(0, sizeof(GLuint));
+         cull_dispatch.clear(4 * sizeof(GLuint), sizeof(GLuint));
+         cull_dispatch.clear(7 * sizeof(GLuint), sizeof(GLuint));
+
+         cull_timer.begin();
+
+         // Bin the blocks into grid cells.
          // Compute shader! :D
-         cull_shader.use();
-         model.bind_indexed(GL_SHADER_STORAGE_BUFFER, 0);
-         for (unsigned i = 0; i < 3; i++)
-            culled_buffer[i].bind_indexed(GL_SHADER_STORAGE_BUFFER, i + 1);
-         indirect.bind_indexed(GL_ATOMIC_COUNTER_BUFFER, 0); // Instance count is written here.
+         bin_shader.use();
+         positions.bind_indexed(GL_SHADER_STORAGE_BUFFER, 0);
+         cull_grid.bind_indexed(GL_UNIFORM_BUFFER, 4);
+         cell_counts.bind_indexed(GL_SHADER_STORAGE_BUFFER, 4);
+         cell_members.bind_indexed(GL_SHADER_STORAGE_BUFFER, 5);
          glDispatchCompute(size, size, size);
-         indirect.unbind_indexed(GL_ATOMIC_COUNTER_BUFFER, 0);
-         model.unbind_indexed(GL_SHADER_STORAGE_BUFFER, 0);
-         for (unsigned i = 0; i < 3; i++)
-            culled_buffer[i].unbind_indexed(GL_SHADER_STORAGE_BUFFER, i + 1);
+         glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+         // Frustum cull whole cells, surviving ones queue their members in chunks.
+         cells_shader.use();
+         cell_chunks.bind_indexed(GL_SHADER_STORAGE_BUFFER, 6);
+         cull_dispatch.bind_indexed(GL_SHADER_STORAGE_BUFFER, 7);
+         glDispatchCompute((num_cells + 1 + 63) / 64, 1, 1);
+         glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+         // Frustum and occlusion cull the blocks of visible cells and update indirect draw buffer.
+         // Blocks hidden by last frame's depth are queued for a second test.
+         cull_shader.set_define(retest_define, 0);
+         cull_shader.use();
+         culled_lists.bind_indexed(GL_SHADER_STORAGE_BUFFER, 1);
+         lod_buffer.bind_indexed(GL_UNIFORM_BUFFER, 7);
+         retest_list.bind_indexed(GL_SHADER_STORAGE_BUFFER, 9);
+         occlusion_buffer.bind();
+         if (pyramid_valid)
+         {
+            depth_pyramid.bind(0);
+            Sampler::bind(0, Sampler::PointClamp);
+         }
+         // Instance count is written here.
+         indirect.bind_indexed(GL_SHADER_STORAGE_BUFFER, 8, commands_offset, 2 * pass_words * sizeof(GLuint));
+         cull_dispatch.bind(GL_DISPATCH_INDIRECT_BUFFER);
+         glDispatchComputeIndirect(0);
+         // Storage and dispatch bindings are left as is, nothing else in the frame uses them.
+
+         cull_timer.end();
 
          // GL must wait until previous shader has made updated data visible.
          // We use updated shader storage buffer in next frame, so just barrier it here.
          glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
 
+         timed_draw(draw_timer, commands_offset);
+
+         if (!occlusion)
+            return;
+
+         // Rebuild the pyramid from what was drawn so far. Everything in it
+         // is visible this frame, so it only hides what is really hidden.
+         if (width != pyramid_width || height != pyramid_height)
+         {
+            depth_copy.init({Texture::Texture2D, 1, GL_DEPTH_COMPONENT32F, width, height});
+            depth_pyramid.init({Texture::Texture2D, 0, GL_R32F, width, height});
+            pyramid_width = width;
+            pyramid_height = height;
+         }
+         depth_copy.copy_framebuffer(0, width, height);
+
+         hiz_shader.set_define(from_depth_define, 1);
+         hiz_shader.use();
+         depth_copy.bind(0);
+         Sampler::bind(0, Sampler::PointClamp);
+         for (unsigned level = 0; level < depth_pyramid.get_desc().levels; level++)
+         {
+            if (level == 1)
+            {
+               hiz_shader.set_define(from_depth_define, 0);
+               hiz_shader.use();
+            }
+
+            if (level > 0)
+               depth_pyramid.bind_image(0, Texture::ReadOnly, level - 1);
+            depth_pyramid.bind_image(1, Texture::WriteOnly, level);
+
+            unsigned level_width = std::max(width >> level, 1u);
+            unsigned level_height = std::max(height >> level, 1u);
+            glDispatchCompute((level_width + 7) / 8, (level_height + 7) / 8, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+         }
+         depth_pyramid.unbind_image(0);
+         depth_pyramid.unbind_image(1);
+
+         pyramid_vp = view_proj;
+         pyramid_valid = true;
+
+         // Test the queued blocks against this frame's pyramid, the visible
+         // ones go to the second set of draw commands.
+         cull_shader.set_define(retest_define, 1);
+         cull_shader.use();
+         depth_pyramid.bind(0);
+         Sampler::bind(0, Sampler::PointClamp);
+         glDispatchComputeIndirect(4 * sizeof(GLuint));
+         glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+         timed_draw(retest_draw_timer, commands_offset + pass_words * sizeof(GLuint));
+      }
+
+      // Times both draw passes with their define changes, to compare permuted and
+      // uber shaders. The CPU side covers issuing the draws, not executing them.
+      void timed_draw(GpuTimer& timer, GLintptr offset)
+      {
+         auto start_time = chrono::steady_clock::now();
+         timer.begin();
+         draw(offset);
+         timer.end();
+         draw_cpu_ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
+      }
+
+      void log_timings()
+      {
+         const char *mode = uber_shader ? "uber" : "permuted";
+         Log::log("Box draws: %.3f ms CPU per frame (%u frames, %s shader).",
+               draw_cpu_ms / draw_cpu_frames, draw_cpu_frames, mode);
+         draw_cpu_ms = 0.0;
+         draw_cpu_frames = 0;
+
+         double ms, retest_ms;
+         unsigned samples, retest_samples;
+         if (draw_timer.average(ms, samples))
+         {
+            if (retest_draw_timer.average(retest_ms, retest_samples))
+               Log::log("Box draws: %.3f + %.3f ms GPU (%u + %u samples, %s shader).",
+                     ms, retest_ms, samples, retest_samples, mode);
+            else
+               Log::log("Box draws: %.3f ms GPU (%u samples, %s shader).", ms, samples, mode);
+         }
+         if (cull_timer.average(ms, samples))
+            Log::log("Box culling: %.3f ms GPU (%u samples).", ms, samples);
+      }
+
+      // Draws one cull pass' worth of blocks with the commands at offset.
+      void draw(GLintptr offset)
+      {
          // Render instanced data.
          Sampler::bind(0, Sampler::TrilinearClamp);
 
-         render_shader.use();
          if (use_diffuse)
-         {
             tex.bind(0);
-            render_shader.set_define("DIFFUSE_MAP", 1);
-         }
-         else
-            render_shader.set_define("DIFFUSE_MAP", 0);
+         render_shader.set_define(diffuse_map_define, use_diffuse);
 
          indirect.bind();
-         for (unsigned i = 0; i < 2; i++)
+         for (unsigned i = 0; i < num_lods; i++)
          {
-            render_shader.set_define("LOD", i);
-            render_array[i].bind();
-            material[i].bind();
+            auto& lod = lods[i];
+            auto command = reinterpret_cast<void*>(offset + i * uintptr_t(sizeof(IndirectCommand)));
+            if (lod.points)
+               render_shader_point.use();
+            else
+            {
+               // Only the finest level gets specular highlights.
+               render_shader.set_define(lod_define, i != 0);
+               render_shader.use();
+               lod.transform.bind_indexed(GL_UNIFORM_BUFFER, Shader::ModelTransform);
+            }
+            lod.array.bind();
+            lod.material.bind_indexed(GL_UNIFORM_BUFFER, Shader::Material);
 
             // glMultiDrawElementsIndirect is possible, but I had issues getting it to work.
             // Only possible if all LOD levels use same shader though ...
-            glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
-                  reinterpret_cast<void*>(i * uintptr_t(sizeof(IndirectCommand))));
+            if (lod.points)
+               glDrawArraysIndirect(GL_POINTS, command);
+            else
+               glDrawElementsIndirect(GL_TRIANGLES, lod.index_type, command);
          }
 
-         // Draw farthest blocks as point sprites.
-         render_shader_point.use();
-         render_array[2].bind();
-         material[2].bind();
-         glDrawArraysIndirect(GL_POINTS, reinterpret_cast<void*>(2 * uintptr_t(sizeof(IndirectCommand))));
-
          indirect.unbind();
 
          if (use_diffuse)
             tex.unbind(0);
 
-         Sampler::unbind(0, Sampler::TrilinearClamp);
-         render_shader_point.unbind();
-         render_array[2].unbind();
-         material[2].unbind();
+         // Sampler, program and vertex array are replaced by the next pass
+         // right after, unbinding them here would only add state changes.
       }
 
+      Shader physics_shader;
+      Shader bin_shader;
+      Shader cells_shader;
       Shader cull_shader;
+      Shader hiz_shader;
       Shader render_shader;
       Shader render_shader_point;
+      Shader::DefineHandle diffuse_map_define;
+      Shader::DefineHandle lod_define;
+      Shader::DefineHandle retest_define;
+      Shader::DefineHandle from_depth_define;
+      GpuTimer draw_timer;
+      GpuTimer retest_draw_timer;
+      GpuTimer cull_timer;
+      double draw_cpu_ms = 0.0;
+      unsigned draw_cpu_frames = 0;
+
+      BufferPool mesh_pool{GL_ARRAY_BUFFER};
+      BufferPool uniform_pool{GL_UNIFORM_BUFFER, Buffer::None, 64 * 1024};
+      BufferPool grid_pool{GL_SHADER_STORAGE_BUFFER, Buffer::Copy};
+
+      static constexpr float block_radius = 1.4143f;
+
+      // Blocks start on a grid of (2 * grid_base)^3 points, grid_spacing apart.
+      static const int grid_base = 48;
+      static const int grid_spacing = 8;
+
+      static void generate_positions(void *data, bool compact)
+      {
+         auto blocks = static_cast<float*>(data);
+         for (int z = -grid_base; z < grid_base; z++)
+            for (int y = -grid_base; y < grid_base; y++)
+               for (int x = -grid_base; x < grid_base; x++)
+               {
+                  *blocks++ = x * grid_spacing;
+                  *blocks++ = y * grid_spacing;
+                  *blocks++ = z * grid_spacing;
+                  if (!compact)
+                     *blocks++ = block_radius;
+               }
+      }
+
+#ifdef CHECK_COMPACT_BLOCKS
+      bool layouts_checked = false;
+
+      // Steps both block layouts from the initial state and logs how far the
+      // compact one ends up from the float one. Needs the global vertex data bound.
+      void check_block_layouts(unsigned steps)
+      {
+         Buffer check_positions[2];
+         Buffer check_velocities[2];
+         for (unsigned compact = 0; compact < 2; compact++)
+         {
+            check_positions[compact].init_generated(GL_SHADER_STORAGE_BUFFER,
+                  num_blocks * (compact ? sizeof(vec3) : sizeof(vec4)), Buffer::ReadOnly,
+                  [compact](void *data, GLsizei) {
+                     generate_positions(data, compact);
+                  });
+            check_velocities[compact].init_generated(GL_SHADER_STORAGE_BUFFER,
+                  num_blocks * (compact ? 2 * sizeof(GLuint) : sizeof(vec4)), Buffer::ReadOnly,
+                  [](void *data, GLsizei size) {
+                     memset(data, 0, size);
+                  });
+         }
+
+         Simulation *simulation;
+         if (!simulation_buffer.map(simulation))
+            return;
+         simulation->step = physics_step;
+         simulation->steps = 1;
+         simulation->num_blocks = num_blocks;
+         simulation_buffer.unmap();
+
+         // One dispatch per step, so the compact state is rounded as often as it
+         // can be in simulate(). The layout not built is compiled on the spot.
+         for (unsigned compact = 0; compact < 2; compact++)
+         {
+            physics_shader.set_define("COMPACT_BLOCKS", compact);
+            physics_shader.use();
+            simulation_buffer.bind();
+            check_positions[compact].bind_indexed(GL_SHADER_STORAGE_BUFFER, 0);
+            check_velocities[compact].bind_indexed(GL_SHADER_STORAGE_BUFFER, 1);
+            for (unsigned i = 0; i < steps; i++)
+            {
+               glDispatchCompute((num_blocks + 63) / 64, 1, 1);
+               glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            }
+         }
+         physics_shader.set_define("COMPACT_BLOCKS", compact_blocks);
+         glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+         const float *pos[2];
+         const void *vel[2];
+         for (unsigned compact = 0; compact < 2; compact++)
+            if (!check_positions[compact].map(pos[compact]) || !check_velocities[compact].map(vel[compact]))
+               return;
+
+         vector<float> pos_errors(num_blocks), vel_errors(num_blocks);
+         auto vel_float = static_cast<const vec4*>(vel[0]);
+         auto vel_halves = static_cast<const uint16_t*>(vel[1]);
+         for (GLuint i = 0; i < num_blocks; i++)
+         {
+            vec3 p0 = vec3(pos[0][4 * i], pos[0][4 * i + 1], pos[0][4 * i + 2]);
+            vec3 p1 = vec3(pos[1][3 * i], pos[1][3 * i + 1], pos[1][3 * i + 2]);
+            pos_errors[i] = length(p1 - p0);
+
+            vec3 v0 = vec3(vel_float[i]);
+            vec3 v1 = vec3(half_to_float(vel_halves[4 * i]), half_to_float(vel_halves[4 * i + 1]),
+                  half_to_float(vel_halves[4 * i + 2]));
+            vel_errors[i] = 100.0f * length(v1 - v0) / std::max(length(v0), 1e-6f);
+         }
+
+         for (unsigned compact = 0; compact < 2; compact++)
+         {
+            check_positions[compact].unmap();
+            check_velocities[compact].unmap();
+         }
+
+         Log::log("Compact blocks after %u steps, %u blocks:", steps, num_blocks);
+         log_errors("position error", pos_errors, "units");
+         log_errors("velocity error", vel_errors, "%");
+      }
 
-      Buffer vert, vert_fine;
-      Buffer elem, elem_fine;
-      Buffer culled_buffer[3];
-      VertexArray render_array[3];
+      static float half_to_float(uint16_t half)
+      {
+         int exponent = (half >> 10) & 0x1f;
+         int mantissa = half & 0x3ff;
+         float value;
+         if (exponent == 0)
+            value = ldexpf(float(mantissa), -24);
+         else if (exponent == 0x1f)
+            value = mantissa ? NAN : INFINITY;
+         else
+            value = ldexpf(float(mantissa | 0x400), exponent - 25);
+         return half & 0x8000 ? -value : value;
+      }
+
+      static void log_errors(const char *what, vector<float>& errors, const char *unit)
+      {
+         double total = 0.0;
+         for (auto error : errors)
+            total += error;
+         sort(begin(errors), end(errors));
+         Log::log("  %s max %.3g, p99 %.3g, mean %.3g %s.", what, errors.back(),
+               errors[errors.size() * 99 / 100], total / errors.size(), unit);
+      }
+#endif
 
-      size_t indices_fine;
-      size_t indices;
+      // Blocks move in fixed steps, independent of the frame rate. After a
+      // stall the simulation slows down rather than catching up all at once.
+      static constexpr double physics_step = 1.0 / 120.0;
+      static const unsigned max_physics_steps = 8;
 
-      Buffer model;
-      Buffer material[3];
+      // Matches Simulation in boxphysics.cs.
+      struct Simulation
+      {
+         float step;
+         GLuint steps;
+         GLuint num_blocks;
+      };
+
+      Buffer simulation_buffer;
+      double physics_time = 0.0; // Simulation time owed to the blocks.
+
+      // Matches CullGrid in the cull shaders.
+      struct CullGrid
+      {
+         vec4 origin; // xyz: Minimum corner, w: cell size.
+         uvec4 dims; // xyz: Cells per axis, w: member capacity of a cell.
+         float radius; // Largest block radius, cells are grown by it.
+         float padding[3];
+      };
+
+      // Members of a cell are culled in chunks of this size, see boxcells.cs.
+      static const GLuint chunk_size = 256;
+
+      BufferRange cull_grid;
+      BufferRange cell_counts; // Per cell, plus one for the overflow list.
+      BufferRange cell_members;
+      BufferRange cell_chunks;
+      Buffer cull_dispatch;
+      GLuint num_cells;
+
+      // Matches Occlusion in boxcull.cs.
+      struct Occlusion
+      {
+         mat4 previous_vp;
+         GLuint previous_valid;
+      };
+
+      BufferRange retest_list; // Blocks the first cull pass found hidden.
+      Buffer occlusion_buffer;
+      Texture depth_copy;
+      Texture depth_pyramid; // Farthest depth per texel and level.
+      GLint sample_buffers = -1; // Of the back buffer, -1 until queried.
+      unsigned pyramid_width = 0;
+      unsigned pyramid_height = 0;
+      mat4 pyramid_vp;
+      bool pyramid_valid = false;
+
+      // Matches MAX_LODS in boxcull.cs.
+      static const unsigned max_lods = 8;
+      static_assert(sizeof(lod_table) / sizeof(lod_table[0]) <= max_lods, "Too many LOD levels.");
+
+      // GL side of a lod_table level.
+      struct Lod
+      {
+         bool points;
+         BufferRange vert, elem; // Not used by point sprites.
+         BufferRange culled; // Instances to draw.
+         BufferRange material;
+         BufferRange transform;
+         VertexArray array;
+         GLenum index_type;
+         GLuint count_word; // Instance count in a pass' commands, see IndirectCommand.
+      };
+
+      // Matches LodTable in boxcull.cs.
+      struct LodTableBuffer
+      {
+         GLuint num_lods;
+         GLuint pass_words;
+         GLuint padding[2];
+         struct
+         {
+            float min_size;
+            GLuint count_word;
+            GLuint first_word;
+            GLuint list_offset;
+         } levels[max_lods];
+      };
+
+      Lod lods[max_lods];
+
+      // Mesh processing results, built on the thread pool.
+      struct LodMeshes
+      {
+         vector<Mesh> meshes;
+         vector<Meshlet> meshlets; // Of level 0, in object space.
+      };
+
+      // Clusters of the level 0 mesh for culling below instance granularity,
+      // an array of Meshlet in std430 layout.
+      BufferRange meshlets;
+      unsigned num_meshlets = 0;
+      unsigned num_lods;
+      Buffer culled_lists; // Instance lists of all levels, one after the other.
+      BufferRange lod_buffer;
+
+      // Structure of arrays, so culling only reads the positions.
+      GLuint num_blocks;
+      Buffer positions; // xyz: Center, w: Radius. Only the center with compact_blocks.
+      Buffer velocities; // Packed into half floats with compact_blocks.
       Buffer indirect;
+      unsigned frame_count = 0;
+
+      // glDrawElementsIndirect layout. Point sprites reuse it for glDrawArraysIndirect,
+      // where count sits in the first field and primCount is fixed at 1.
+      struct IndirectCommand
+      {
+         GLuint count;
+         GLuint primCount; // Incremented by the cull shader.
+         GLuint firstIndex;
+         GLuint baseVertex;
+         GLuint baseInstance; // Written by the second cull pass for its commands.
+      };
+
+      // Commands of one pass hold one command per level, in lod_table order.
+      // Sets of both passes are commands_stride apart.
+      GLuint pass_words;
+      GLsizeiptr commands_stride;
 
       Texture tex;
       bool use_diffuse;
       float cache_depth;
       unsigned size;
-
-      vector<vec4> blocks;
 };
 
 class BoxesApp : public LibretroGLApplication
@@ -283,6 +901,7 @@ class BoxesApp : public LibretroGLApplication
       {
          width = res.width;
          height = res.height;
+         scene.viewport_changed();
 
          update_global_data();
       }
@@ -335,7 +954,11 @@ class BoxesApp : public LibretroGLApplication
          global_buffer.bind();
          global_fragment_buffer.bind();
 
-         scene.render(global.vp);
+         if (scene.ready())
+         {
+            scene.simulate(delta);
+            scene.render(global.vp, width, height);
+         }
 
          skybox.tex.bind(0);
          Sampler::bind(0, Sampler::TrilinearClamp);
@@ -359,17 +982,17 @@ class BoxesApp : public LibretroGLApplication
 
       void load() override
       {
-         global_buffer.init(GL_UNIFORM_BUFFER, sizeof(global), Buffer::WriteOnly, nullptr, Shader::GlobalVertexData);
+         global_buffer.init(GL_UNIFORM_BUFFER, sizeof(global), Buffer::Stream, nullptr, Shader::GlobalVertexData);
          global_fragment_buffer.init(GL_UNIFORM_BUFFER,
-               sizeof(global_fragment), Buffer::WriteOnly, nullptr, Shader::GlobalFragmentData);
+               sizeof(global_fragment), Buffer::Stream, nullptr, Shader::GlobalFragmentData);
 
          player_pos = vec3(0, 0, 500);
          player_look_dir = vec3(0, 0, -1);
          player_view_deg_x = 0.0f;
          player_view_deg_y = 0.0f;
 
-         scene.init();
-
+         // Asset decoding runs on the thread pool, start the skybox first so it overlaps the scene.
+         auto start_time = chrono::steady_clock::now();
          skybox.tex.load_texture({Texture::TextureCube, {
                   "app/xpos.png",
                   "app/xneg.png",
@@ -379,6 +1002,12 @@ class BoxesApp : public LibretroGLApplication
                   "app/zneg.png",
                }, true});
          skybox.shader.init("app/shaders/skybox.vs", "app/shaders/skybox.fs");
+         skybox.shader.precompile();
+
+         scene.init();
+
+         auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time);
+         Log::log("Scene loaded in %.3f ms.", elapsed.count());
          vector<int8_t> vertices = { -1, -1, 1, -1, -1, 1, 1, 1 };
          skybox.vertex.init(GL_ARRAY_BUFFER, 8, Buffer::None, vertices.data());
          skybox.arrays.setup({{Shader::VertexLocation, 2, GL_BYTE, GL_FALSE}}, { &skybox.vertex }, nullptr);
@@ -0,0 +1,77 @@
+// Bins the blocks into grid cells, after boxphysics.cs has moved them.
+layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+
+layout(binding = 4) uniform CullGrid
+{
+   vec4 origin; // xyz: Minimum corner, w: cell size.
+   uvec4 dims; // xyz: Cells per axis, w: member capacity of a cell.
+   float radius; // Largest instance radius.
+} grid;
+
+#if COMPACT_BLOCKS
+// Centers only, all blocks have the radius of the grid.
+layout(binding = 0) buffer Positions
+{
+   readonly float positions[];
+} source_pos;
+
+vec4 load_point(uint index)
+{
+   return vec4(source_pos.positions[3u * index],
+         source_pos.positions[3u * index + 1u],
+         source_pos.positions[3u * index + 2u], grid.radius);
+}
+#else
+layout(binding = 0) buffer Positions
+{
+   readonly vec4 positions[];
+} source_pos;
+
+vec4 load_point(uint index)
+{
+   return source_pos.positions[index];
+}
+#endif
+
+// One counter per cell, the last one counts the overflow list.
+layout(binding = 4) buffer CellCounts
+{
+   uint counts[];
+} cells;
+
+// Fixed size member lists per cell, followed by the overflow list.
+layout(binding = 5) buffer CellMembers
+{
+   uint members[];
+} cell_members;
+
+uint get_invocation()
+{
+   uint work_group = gl_WorkGroupID.x * gl_NumWorkGroups.y * gl_NumWorkGroups.z + gl_WorkGroupID.y * gl_NumWorkGroups.z + gl_WorkGroupID.z;
+   return work_group * gl_WorkGroupSize.x * gl_WorkGroupSize.y * gl_WorkGroupSize.z + gl_LocalInvocationIndex;
+}
+
+void main()
+{
+   uint invocation = get_invocation();
+   vec4 point = load_point(invocation);
+
+   // Bin by center. Instances that left the grid, are bigger than the cells
+   // account for or don't fit their cell go to the overflow list, which is never culled as a whole.
+   uint num_cells = grid.dims.x * grid.dims.y * grid.dims.z;
+   ivec3 cell = ivec3(floor((point.xyz - grid.origin.xyz) / grid.origin.w));
+   if (all(greaterThanEqual(cell, ivec3(0))) && all(lessThan(cell, ivec3(grid.dims.xyz))) && point.w <= grid.radius)
+   {
+      uint index = (uint(cell.z) * grid.dims.y + uint(cell.y)) * grid.dims.x + uint(cell.x);
+      uint slot = atomicAdd(cells.counts[index], 1u);
+      if (slot < grid.dims.w)
+      {
+         cell_members.members[index * grid.dims.w + slot] = invocation;
+         return;
+      }
+      atomicAdd(cells.counts[index], uint(-1)); // Keep counts within capacity.
+   }
+
+   uint slot = atomicAdd(cells.counts[num_cells], 1u);
+   cell_members.members[num_cells * grid.dims.w + slot] = invocation;
+}
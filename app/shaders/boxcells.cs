@@ -0,0 +1,80 @@
+layout(local_size_x = 64) in;
+
+layout(binding = GLOBAL_VERTEX_DATA) uniform GlobalVertexData
+{
+   mat4 vp;
+   mat4 view;
+   mat4 view_nt;
+   mat4 proj;
+   mat4 inv_vp;
+   mat4 inv_view;
+   mat4 inv_view_nt;
+   mat4 inv_proj;
+   vec4 camera_pos;
+   vec4 camera_vel;
+   vec4 resolution;
+   vec4 frustum[6];
+   float delta_time;
+} global_vert;
+
+layout(binding = 4) uniform CullGrid
+{
+   vec4 origin; // xyz: Minimum corner, w: cell size.
+   uvec4 dims; // xyz: Cells per axis, w: member capacity of a cell.
+   float radius; // Largest instance radius.
+} grid;
+
+layout(binding = 4) buffer CellCounts
+{
+   readonly uint counts[];
+} cells;
+
+// Work for the instance pass, one entry per chunk of CHUNK_SIZE members: cell << 16 | chunk.
+layout(binding = 6) buffer CellChunks
+{
+   writeonly uint chunks[];
+} cell_chunks;
+
+// glDispatchComputeIndirect arguments, x counts chunks.
+layout(binding = 7) buffer Dispatch
+{
+   uint num_groups_x;
+   uint num_groups_y;
+   uint num_groups_z;
+} dispatch;
+
+#define CHUNK_SIZE 256u
+
+void main()
+{
+   uint index = gl_GlobalInvocationID.x;
+   uint num_cells = grid.dims.x * grid.dims.y * grid.dims.z;
+   if (index > num_cells)
+      return;
+
+   uint count = cells.counts[index];
+   if (count == 0u)
+      return;
+
+   // The overflow list has no bounds, it is always processed.
+   if (index < num_cells)
+   {
+      uvec3 cell = uvec3(index % grid.dims.x, (index / grid.dims.x) % grid.dims.y, index / (grid.dims.x * grid.dims.y));
+      vec3 lo = grid.origin.xyz + vec3(cell) * grid.origin.w - grid.radius;
+      vec3 hi = lo + grid.origin.w + 2.0 * grid.radius;
+
+      // Culled if the corner farthest along a plane normal is still behind it.
+      for (int i = 0; i < 6; i++)
+      {
+         vec4 plane = global_vert.frustum[i];
+         vec3 corner = mix(lo, hi, greaterThanEqual(plane.xyz, vec3(0.0)));
+         if (dot(vec4(corner, 1.0), plane) < 0.0)
+            return;
+      }
+   }
+
+   uint num_chunks = (count + CHUNK_SIZE - 1u) / CHUNK_SIZE;
+   uint first = atomicAdd(dispatch.num_groups_x, num_chunks);
+   for (uint i = 0u; i < num_chunks; i++)
+      cell_chunks.chunks[first + i] = (index << 16) | i;
+}
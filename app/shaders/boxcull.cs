@@ -1,4 +1,22 @@
-layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+// Runs in two passes. The first one takes one work group per chunk of a
+// visible cell (see boxcells.cs) and tests blocks against last frame's depth
+// pyramid. Blocks it finds hidden are queued for the second pass (RETEST),
+// which tests them again once the pyramid has been rebuilt from this frame's
+// first draws, and appends the ones that turned out visible.
+//
+// Surviving blocks are compacted per work group, so each group does one
+// global atomic per LOD instead of one per block. Subgroup ballots do most
+// of the counting if the application could enable them, shared memory
+// atomics otherwise.
+#if defined(GL_KHR_shader_subgroup_ballot)
+#define BALLOT 1
+#elif defined(GL_ARB_shader_ballot) && defined(GL_ARB_gpu_shader_int64)
+#define BALLOT 1
+#else
+#define BALLOT 0
+#endif
+
+layout(local_size_x = 64) in;
 
 layout(binding = GLOBAL_VERTEX_DATA) uniform GlobalVertexData
 {
@@ -17,89 +35,334 @@ layout(binding = GLOBAL_VERTEX_DATA) uniform GlobalVertexData
    float delta_time;
 } global_vert;
 
-layout(binding = 0, offset = 4) uniform atomic_uint lod0_cnt; // Outputs to instance variable.
-layout(binding = 0, offset = 24) uniform atomic_uint lod1_cnt;
-layout(binding = 0, offset = 40) uniform atomic_uint lod2_cnt; // not 44 since we're using point sprites here with glDrawArraysIndirect.
+layout(binding = 4) uniform CullGrid
+{
+   vec4 origin; // xyz: Minimum corner, w: cell size.
+   uvec4 dims; // xyz: Cells per axis, w: member capacity of a cell.
+   float radius; // Largest instance radius.
+} grid;
+
+layout(binding = 5) uniform Occlusion
+{
+   mat4 previous_vp; // The depth pyramid was built with this, used by the first pass.
+   uint previous_valid;
+} occlusion;
+
+// Farthest depth per texel, see hiz.cs.
+layout(binding = 0) uniform sampler2D depth_pyramid;
 
-struct Point
+// Draw commands of this frame as words, instance counts are added up here.
+// The second pass has its own set of commands right after the first. Its
+// instances go behind those of the first, so it starts at the first's counts.
+layout(binding = 8) buffer Commands
 {
-   vec4 pos;
-   vec4 vel;
+   uint words[];
+} commands;
+
+// Matches max_lods in boxes.cpp.
+#define MAX_LODS 8u
+
+struct LodLevel
+{
+   float min_size; // Smallest projected radius in pixels drawn with this level.
+   uint count_word; // Instance count in the first pass' commands.
+   uint first_word; // First instance in the first pass' commands.
+   uint list_offset; // Start of the level's list in culled.pos.
 };
 
-layout(binding = 0) buffer SourceData
+// Levels go from finest to coarsest, the last one takes everything left.
+layout(binding = 7) uniform LodTable
 {
-   Point points[];
-} source_data;
+   uint num_lods;
+   uint pass_words; // Words of one pass' commands.
+   LodLevel levels[MAX_LODS];
+} lod_table;
+
+#if RETEST
+#define PASS_WORDS lod_table.pass_words
+#else
+#define PASS_WORDS 0u
+#endif
 
-layout(binding = 1) buffer DestData0
+// Written by boxphysics.cs.
+#if COMPACT_BLOCKS
+// Centers only, all blocks have the radius of the grid.
+layout(binding = 0) buffer Positions
 {
-   writeonly vec4 pos[];
-} culled0;
+   readonly float positions[];
+} source_pos;
 
-layout(binding = 2) buffer DestData1
+vec4 load_point(uint index)
 {
-   writeonly vec4 pos[];
-} culled1;
+   return vec4(source_pos.positions[3u * index],
+         source_pos.positions[3u * index + 1u],
+         source_pos.positions[3u * index + 2u], grid.radius);
+}
+#else
+// xyz: Center, w: Radius.
+layout(binding = 0) buffer Positions
+{
+   readonly vec4 positions[];
+} source_pos;
 
-layout(binding = 3) buffer DestData2
+vec4 load_point(uint index)
+{
+   return source_pos.positions[index];
+}
+#endif
+
+// Instance lists of all levels, one after the other.
+layout(binding = 1) buffer DestData
 {
    writeonly vec4 pos[];
-} culled2;
+} culled;
 
-uint get_invocation()
+layout(binding = 4) buffer CellCounts
 {
-   uint work_group = gl_WorkGroupID.x * gl_NumWorkGroups.y * gl_NumWorkGroups.z + gl_WorkGroupID.y * gl_NumWorkGroups.z + gl_WorkGroupID.z;
-   return work_group * gl_WorkGroupSize.x * gl_WorkGroupSize.y * gl_WorkGroupSize.z + gl_LocalInvocationIndex;
+   readonly uint counts[];
+} cells;
+
+layout(binding = 5) buffer CellMembers
+{
+   readonly uint members[];
+} cell_members;
+
+layout(binding = 6) buffer CellChunks
+{
+   readonly uint chunks[];
+} cell_chunks;
+
+// glDispatchComputeIndirect arguments of both passes, the first part belongs to boxcells.cs.
+layout(binding = 7) buffer Dispatch
+{
+   uint cell_groups[4];
+   uint retest_groups[3]; // x counts groups of retest_count.
+   uint retest_count;
+} dispatch;
+
+layout(binding = 9) buffer Retest
+{
+   uint instances[];
+} retest;
+
+#define CHUNK_SIZE 256u
+
+#define CULLED MAX_LODS
+
+// Where this pass starts appending to each instance list.
+shared uint first_instance[MAX_LODS];
+shared uint lod_count[MAX_LODS];
+shared uint lod_base[MAX_LODS];
+
+#if BALLOT
+#if defined(GL_KHR_shader_subgroup_ballot)
+uvec4 ballot(bool value) { return subgroupBallot(value); }
+uint ballot_count(uvec4 bits) { return subgroupBallotBitCount(bits); }
+uint ballot_rank(uvec4 bits) { return subgroupBallotExclusiveBitCount(bits); }
+bool ballot_elect() { return subgroupElect(); }
+uint ballot_broadcast(uint value) { return subgroupBroadcastFirst(value); }
+#else
+uvec4 ballot(bool value) { return uvec4(unpackUint2x32(ballotARB(value)), 0u, 0u); }
+uint ballot_count(uvec4 bits) { return uint(bitCount(bits.x) + bitCount(bits.y)); }
+
+uint ballot_rank(uvec4 bits)
+{
+   uvec2 lower = unpackUint2x32(gl_SubGroupLtMaskARB);
+   return uint(bitCount(bits.x & lower.x) + bitCount(bits.y & lower.y));
 }
 
-void main()
+bool ballot_elect() { return readFirstInvocationARB(gl_SubGroupInvocationARB) == gl_SubGroupInvocationARB; }
+uint ballot_broadcast(uint value) { return readFirstInvocationARB(value); }
+#endif
+#endif
+
+// Appends the points of the whole work group to the lists of their LOD.
+// Must be reached by all invocations, those without a point pass CULLED.
+void append(vec4 point, uint lod)
+{
+   if (gl_LocalInvocationIndex < lod_table.num_lods)
+      lod_count[gl_LocalInvocationIndex] = 0u;
+   barrier();
+
+   // Place within the work group.
+   uint slot = 0u;
+#if BALLOT
+   bool leader = ballot_elect();
+   for (uint i = 0u; i < lod_table.num_lods; i++)
+   {
+      uvec4 bits = ballot(lod == i);
+      uint count = ballot_count(bits);
+      if (count == 0u)
+         continue;
+
+      // One shared atomic per subgroup, its lanes are ranked by the ballot.
+      uint subgroup_base = 0u;
+      if (leader)
+         subgroup_base = atomicAdd(lod_count[i], count);
+      subgroup_base = ballot_broadcast(subgroup_base);
+      if (lod == i)
+         slot = subgroup_base + ballot_rank(bits);
+   }
+#else
+   if (lod != CULLED)
+      slot = atomicAdd(lod_count[lod], 1u);
+#endif
+   barrier();
+
+   // Place of the work group within the lists.
+   if (gl_LocalInvocationIndex < lod_table.num_lods && lod_count[gl_LocalInvocationIndex] != 0u)
+   {
+      uint i = gl_LocalInvocationIndex;
+      lod_base[i] = lod_table.levels[i].list_offset + first_instance[i] +
+         atomicAdd(commands.words[PASS_WORDS + lod_table.levels[i].count_word], lod_count[i]);
+   }
+   barrier();
+
+   if (lod != CULLED)
+      culled.pos[lod_base[lod] + slot] = point;
+}
+
+// True if the bounding box of the sphere is behind the depth pyramid
+// everywhere it projects to. Anything touching the camera plane is visible.
+bool occluded(vec4 point, mat4 vp)
 {
-   uint invocation = get_invocation();
-   vec4 point = source_data.points[invocation].pos;
-   vec4 vel = source_data.points[invocation].vel;
+   vec2 lo = vec2(1.0);
+   vec2 hi = vec2(-1.0);
+   float nearest = 1.0;
+   for (int i = 0; i < 8; i++)
+   {
+      vec3 corner = point.xyz + point.w * vec3(
+            (i & 1) != 0 ? 1.0 : -1.0,
+            (i & 2) != 0 ? 1.0 : -1.0,
+            (i & 4) != 0 ? 1.0 : -1.0);
+      vec4 clip = vp * vec4(corner, 1.0);
+      if (clip.w <= 0.0)
+         return false;
+
+      vec3 ndc = clip.xyz / clip.w;
+      lo = min(lo, ndc.xy);
+      hi = max(hi, ndc.xy);
+      nearest = min(nearest, ndc.z);
+   }
 
-   // "Physics" :D
-   vec3 dist = point.xyz - global_vert.camera_pos.xyz;
-   float dist_len_sq = dot(dist, dist);
+   // Outside of the pyramid there is nothing to test against.
+   if (any(lessThan(lo, vec2(-1.0))) || any(greaterThan(hi, vec2(1.0))))
+      return false;
 
-   vec3 accel_neg = 20000.0 * -normalize(dist) / (dot(dist, dist) + 0.001);
-   point.xyz += global_vert.delta_time * vel.xyz;
-   vel.xyz += global_vert.delta_time * accel_neg;
+   // Grown by a pixel, point sprites round their size up when rasterized.
+   ivec2 size = textureSize(depth_pyramid, 0);
+   ivec2 first = max(ivec2((lo * 0.5 + 0.5) * vec2(size)) - 1, ivec2(0));
+   ivec2 last = min(ivec2((hi * 0.5 + 0.5) * vec2(size)) + 1, size - 1);
 
-   vec3 rel_vel = vel.xyz - global_vert.camera_vel.xyz; // Relative velocity to camera.
-   if (dist_len_sq < 10.0 && dot(rel_vel, dist) < 0.0)
-      vel.xyz = reflect(rel_vel, normalize(dist)) + global_vert.camera_vel.xyz; // Bounce factor
+   // Pick the level where the footprint covers at most 2x2 texels.
+   int span = max(last.x - first.x, last.y - first.y);
+   int level = span > 0 ? findMSB(span) + 1 : 0;
+   level = min(level, textureQueryLevels(depth_pyramid) - 1);
 
-   source_data.points[invocation].pos = point;
-   source_data.points[invocation].vel = vel;
+   // Rounded down level sizes leave odd texels to the last row and column.
+   // Not textureSize(), which llvmpipe gets wrong for a non-uniform level.
+   ivec2 level_last = max(size >> level, ivec2(1)) - 1;
+   first = min(first >> level, level_last);
+   last = min(last >> level, level_last);
 
+   float farthest = texelFetch(depth_pyramid, first, level).r;
+   farthest = max(farthest, texelFetch(depth_pyramid, ivec2(last.x, first.y), level).r);
+   farthest = max(farthest, texelFetch(depth_pyramid, ivec2(first.x, last.y), level).r);
+   farthest = max(farthest, texelFetch(depth_pyramid, last, level).r);
+
+   return nearest * 0.5 + 0.5 > farthest;
+}
+
+// Returns the LOD to draw the block with, or CULLED.
+uint cull_instance(uint instance, out vec4 point)
+{
+   point = load_point(instance);
    vec4 pos = vec4(point.xyz, 1.0);
+   float depth = dot(pos, global_vert.frustum[0]);
 
+#if RETEST
+   // Frustum culling was done by the first pass.
+   if (occluded(point, global_vert.vp))
+      return CULLED;
+#else
    // Frustum cull and create instance draw lists.
 
-   float depth = dot(pos, global_vert.frustum[0]);
    if (depth < -point.w) // Culled
-      return;
+      return CULLED;
 
    for (int i = 1; i < 6; i++)
       if (dot(pos, global_vert.frustum[i]) < -point.w) // Culled
-         return;
+         return CULLED;
 
-   if (depth > 500.0) // LOD2
+   if (occlusion.previous_valid != 0u && occluded(point, occlusion.previous_vp))
    {
-      uint counter = atomicCounterIncrement(lod2_cnt);
-      culled2.pos[counter] = point;
+      uint slot = atomicAdd(dispatch.retest_count, 1u);
+      retest.instances[slot] = instance;
+      if ((slot % gl_WorkGroupSize.x) == 0u)
+         atomicAdd(dispatch.retest_groups[0], 1u);
+      return CULLED;
    }
-   else if (depth > 100.0) // LOD1
+#endif
+
+   // Projected radius in pixels, resolution.w is pixels per unit at unit depth.
+   // Blocks reaching the near plane get the finest level.
+   float size = point.w * global_vert.resolution.w / max(depth, 0.001);
+   uint last = lod_table.num_lods - 1u;
+   for (uint i = 0u; i < last; i++)
+      if (size >= lod_table.levels[i].min_size)
+         return i;
+   return last;
+}
+
+// Reads where this pass starts appending, before any append().
+void load_first_instances()
+{
+   uint i = gl_LocalInvocationIndex;
+   if (i < lod_table.num_lods)
    {
-      uint counter = atomicCounterIncrement(lod1_cnt);
-      culled1.pos[counter] = point;
+#if RETEST
+      // Count of the first pass, which is also this pass' first instance.
+      first_instance[i] = commands.words[lod_table.levels[i].count_word];
+      if (gl_WorkGroupID.x == 0u)
+         commands.words[PASS_WORDS + lod_table.levels[i].first_word] = first_instance[i];
+#else
+      first_instance[i] = 0u;
+#endif
    }
-   else // LOD0
+   barrier();
+}
+
+#if RETEST
+void main()
+{
+   load_first_instances();
+
+   uint index = gl_GlobalInvocationID.x;
+   vec4 point = vec4(0.0);
+   uint lod = CULLED;
+   if (index < dispatch.retest_count)
+      lod = cull_instance(retest.instances[index], point);
+   append(point, lod);
+}
+#else
+void main()
+{
+   uint entry = cell_chunks.chunks[gl_WorkGroupID.x];
+   uint cell = entry >> 16;
+   uint first = (entry & 0xffffu) * CHUNK_SIZE;
+   uint count = min(cells.counts[cell] - first, CHUNK_SIZE);
+   uint base = cell * grid.dims.w + first;
+   load_first_instances();
+
+   // Every invocation runs all iterations, append() synchronizes the group.
+   for (uint i = 0u; i < count; i += gl_WorkGroupSize.x)
    {
-      uint counter = atomicCounterIncrement(lod0_cnt);
-      culled0.pos[counter] = point;
+      uint index = i + gl_LocalInvocationIndex;
+      vec4 point = vec4(0.0);
+      uint lod = CULLED;
+      if (index < count)
+         lod = cull_instance(cell_members.members[base + index], point);
+      append(point, lod);
    }
 }
-
+#endif
@@ -0,0 +1,125 @@
+// Advances the blocks by a number of fixed steps. Runs before binning and
+// culling, which only read positions.
+layout(local_size_x = 64) in;
+
+layout(binding = GLOBAL_VERTEX_DATA) uniform GlobalVertexData
+{
+   mat4 vp;
+   mat4 view;
+   mat4 view_nt;
+   mat4 proj;
+   mat4 inv_vp;
+   mat4 inv_view;
+   mat4 inv_view_nt;
+   mat4 inv_proj;
+   vec4 camera_pos;
+   vec4 camera_vel;
+   vec4 resolution;
+   vec4 frustum[6];
+   float delta_time;
+} global_vert;
+
+layout(binding = 6) uniform Simulation
+{
+   float step; // Seconds per step.
+   uint steps;
+   uint num_blocks;
+} simulation;
+
+#if COMPACT_BLOCKS
+// Centers only, all blocks have the radius of the cull grid.
+layout(binding = 0) buffer Positions
+{
+   float positions[];
+} source_pos;
+
+// Half floats, x and y in the first word, z in the second.
+layout(binding = 1) buffer Velocities
+{
+   uvec2 velocities[];
+} source_vel;
+
+vec4 load_position(uint index)
+{
+   return vec4(source_pos.positions[3u * index],
+         source_pos.positions[3u * index + 1u],
+         source_pos.positions[3u * index + 2u], 0.0);
+}
+
+void store_position(uint index, vec4 point)
+{
+   source_pos.positions[3u * index] = point.x;
+   source_pos.positions[3u * index + 1u] = point.y;
+   source_pos.positions[3u * index + 2u] = point.z;
+}
+
+vec4 load_velocity(uint index)
+{
+   uvec2 halves = source_vel.velocities[index];
+   return vec4(unpackHalf2x16(halves.x), unpackHalf2x16(halves.y).x, 0.0);
+}
+
+void store_velocity(uint index, vec4 vel)
+{
+   source_vel.velocities[index] = uvec2(packHalf2x16(vel.xy), packHalf2x16(vec2(vel.z, 0.0)));
+}
+#else
+// Structure of arrays, xyz: Center, w: Radius.
+layout(binding = 0) buffer Positions
+{
+   vec4 positions[];
+} source_pos;
+
+layout(binding = 1) buffer Velocities
+{
+   vec4 velocities[];
+} source_vel;
+
+vec4 load_position(uint index)
+{
+   return source_pos.positions[index];
+}
+
+void store_position(uint index, vec4 point)
+{
+   source_pos.positions[index] = point;
+}
+
+vec4 load_velocity(uint index)
+{
+   return source_vel.velocities[index];
+}
+
+void store_velocity(uint index, vec4 vel)
+{
+   source_vel.velocities[index] = vel;
+}
+#endif
+
+void main()
+{
+   uint index = gl_GlobalInvocationID.x;
+   if (index >= simulation.num_blocks)
+      return;
+
+   vec4 point = load_position(index);
+   vec4 vel = load_velocity(index);
+
+   for (uint i = 0u; i < simulation.steps; i++)
+   {
+      // "Physics" :D
+      vec3 dist = point.xyz - global_vert.camera_pos.xyz;
+      float dist_len_sq = dot(dist, dist);
+
+      vec3 accel_neg = 20000.0 * -normalize(dist) / (dot(dist, dist) + 0.001);
+      point.xyz += simulation.step * vel.xyz;
+      vel.xyz += simulation.step * accel_neg;
+
+      vec3 rel_vel = vel.xyz - global_vert.camera_vel.xyz; // Relative velocity to camera.
+      if (dist_len_sq < 10.0 && dot(rel_vel, dist) < 0.0)
+         vel.xyz = reflect(rel_vel, normalize(dist)) + global_vert.camera_vel.xyz; // Bounce factor
+   }
+
+   store_position(index, point);
+   store_velocity(index, vel);
+}
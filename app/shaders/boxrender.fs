@@ -23,9 +23,8 @@ in VertexData
    vec2 tex;
 } fin;
 
-#if DIFFUSE_MAP
+// DIFFUSE_MAP and LOD may be dynamic, so they are tested with if () below.
 layout(binding = 0) uniform sampler2D Diffuse;
-#endif
 
 out vec4 FragColor;
 
@@ -41,19 +40,20 @@ void main()
    float light_mod = 0.5; // Could attenuate, but don't bother.
 
    vec3 specular = vec3(0.0);
-#if LOD == 0
-   // Avoid pow(0, 0) which is undefined.
-   vec3 half_vec = normalize(vLight + vEye);
-   float blinn_phong_mod = max(dot(half_vec, normal), 0.001);
-   specular = light_mod * global_frag.light_color.rgb * material.specular.xyz * pow(blinn_phong_mod, material.specular_power);
-#endif
-
-#if DIFFUSE_MAP
-   vec4 diffuse_term = texture(Diffuse, fin.tex);
-   diffuse_term.rgb *= diffuse_term.rgb;
-#else
+   if (LOD == 0)
+   {
+      // Avoid pow(0, 0) which is undefined.
+      vec3 half_vec = normalize(vLight + vEye);
+      float blinn_phong_mod = max(dot(half_vec, normal), 0.001);
+      specular = light_mod * global_frag.light_color.rgb * material.specular.xyz * pow(blinn_phong_mod, material.specular_power);
+   }
+
    vec4 diffuse_term = vec4(0.0);
-#endif
+   if (DIFFUSE_MAP != 0)
+   {
+      diffuse_term = texture(Diffuse, fin.tex);
+      diffuse_term.rgb *= diffuse_term.rgb;
+   }
 
    vec3 ambient = global_frag.light_ambient.rgb * mix(material.ambient.rgb, diffuse_term.rgb, diffuse_term.a);
    vec3 diffuse = light_mod * ndotl * global_frag.light_color.rgb * mix(material.diffuse.rgb, diffuse_term.rgb, diffuse_term.a);
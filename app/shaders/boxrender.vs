@@ -11,6 +11,11 @@ layout(binding = GLOBAL_VERTEX_DATA) uniform GlobalVertexData
    vec4 camera_pos;
 } global_vert;
 
+layout(binding = MODEL_TRANSFORM) uniform ModelTransform
+{
+   mat4 transform; // Dequantizes aVertex.
+} model;
+
 layout(location = VERTEX) in vec3 aVertex;
 layout(location = NORMAL) in vec3 aNormal;
 layout(location = TEXCOORD) in vec2 aTexCoord;
@@ -25,7 +30,7 @@ out VertexData
 
 void main()
 {
-   vec4 world = vec4(aVertex + aPos.xyz, 1.0);
+   vec4 world = model.transform * vec4(aVertex, 1.0) + vec4(aPos.xyz, 0.0);
 
    gl_Position = global_vert.vp * world;
 
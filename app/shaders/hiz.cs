@@ -0,0 +1,41 @@
+// Builds one level of the depth pyramid for occlusion culling in boxcull.cs.
+// Every texel keeps the farthest depth below it, so anything nearer than
+// that depth over its whole footprint is hidden.
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#if FROM_DEPTH
+layout(binding = 0) uniform sampler2D depth;
+#else
+layout(binding = 0, r32f) uniform readonly image2D source;
+#endif
+
+layout(binding = 1, r32f) uniform writeonly image2D dest;
+
+void main()
+{
+   ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+   ivec2 size = imageSize(dest);
+   if (any(greaterThanEqual(coord, size)))
+      return;
+
+#if FROM_DEPTH
+   float farthest = texelFetch(depth, coord, 0).r;
+#else
+   // Levels are rounded down, so the last row and column also take in the
+   // odd texel left over in the level above.
+   ivec2 source_size = imageSize(source);
+   ivec2 first = 2 * coord;
+   ivec2 last = min(first + 1, source_size - 1);
+   if (coord.x == size.x - 1)
+      last.x = source_size.x - 1;
+   if (coord.y == size.y - 1)
+      last.y = source_size.y - 1;
+
+   float farthest = 0.0;
+   for (int y = first.y; y <= last.y; y++)
+      for (int x = first.x; x <= last.x; x++)
+         farthest = max(farthest, imageLoad(source, ivec2(x, y)).r);
+#endif
+
+   imageStore(dest, coord, vec4(farthest));
+}
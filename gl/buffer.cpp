@@ -1,13 +1,18 @@
 #include "buffer.hpp"
+#include "state.hpp"
 
 namespace GL
 {
+   // How long a single wait on a stream fence may block before we retry.
+   static const GLuint64 stream_wait_timeout = 1000000000;
+
    void Buffer::init(GLenum target, GLsizei size, GLuint flags, const void *initial_data, GLuint index)
    {
       this->target = target;
       this->size = size;
       this->flags = flags;
       this->index = index;
+      generator = nullptr;
 
       if (alive)
          init_buffer(initial_data);
@@ -22,28 +27,107 @@ namespace GL
          temp.clear();
    }
 
+   void Buffer::init_generated(GLenum target, GLsizei size, GLuint flags, Generator generator, GLuint index)
+   {
+      this->target = target;
+      this->size = size;
+      this->flags = flags;
+      this->index = index;
+      this->generator = std::move(generator);
+      temp.clear();
+      temp.shrink_to_fit();
+
+      if (alive)
+      {
+         init_buffer(nullptr);
+         fill_buffer();
+      }
+   }
+
    void Buffer::reset()
    {
       alive = true;
-      glGenBuffers(1, &id);
+      create_buffer();
 
       if (size && target)
-         init_buffer(temp.empty() ? nullptr : temp.data());
+      {
+         if (generator)
+         {
+            init_buffer(nullptr);
+            fill_buffer();
+         }
+         else
+            init_buffer(temp.empty() ? nullptr : temp.data());
+      }
+   }
+
+   void Buffer::fill_buffer()
+   {
+      void *ptr = stream_ptr;
+      if (!ptr)
+      {
+         ptr = map_range(0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+         if (!ptr)
+            throw std::runtime_error("Failed to map buffer for upload.");
+      }
+
+      generator(ptr, size);
+
+      if (!stream_ptr)
+         unmap_buffer();
    }
 
    void Buffer::destroyed()
    {
       alive = false;
+      deinit_stream();
       if (id)
+      {
          glDeleteBuffers(1, &id);
+         State::get().deleted_buffer(id);
+      }
       id = 0;
    }
 
    void Buffer::unmap()
    {
-      glBindBuffer(target, id);
-      glUnmapBuffer(target);
-      glBindBuffer(target, 0);
+      // Persistent stream mappings stay mapped for the lifetime of the buffer.
+      if (flags == Stream)
+      {
+         if (!stream_mapped)
+            return;
+         stream_mapped = false;
+      }
+
+      unmap_buffer();
+   }
+
+   void Buffer::update(GLintptr offset, GLsizeiptr size, const void *data)
+   {
+      if (!alive)
+         return;
+
+      if (context_caps().direct_state_access)
+         glNamedBufferSubData(id, offset, size, data);
+      else
+      {
+         State::get().bind_buffer(target, id);
+         glBufferSubData(target, offset, size, data);
+         State::get().bind_buffer(target, 0);
+      }
+   }
+
+   void Buffer::clear(GLintptr offset, GLsizeiptr size)
+   {
+      static const GLuint zero = 0;
+      if (context_caps().direct_state_access)
+         glClearNamedBufferSubData(id, GL_R32UI, offset, size, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+      else
+      {
+         State::get().bind_buffer(target, id);
+         glClearBufferSubData(target, GL_R32UI, offset, size, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+         State::get().bind_buffer(target, 0);
+      }
    }
 
    bool Buffer::is_indexed(GLenum type)
@@ -61,38 +145,46 @@ namespace GL
 
    void Buffer::bind_indexed(GLenum target, unsigned index)
    {
-      glBindBufferBase(target, index, id);
+      if (flags == Stream)
+         State::get().bind_buffer_range(target, index, id, stream_offset, size);
+      else
+         State::get().bind_buffer_range(target, index, id);
+   }
+
+   void Buffer::bind_indexed(GLenum target, unsigned index, GLintptr offset, GLsizeiptr size)
+   {
+      State::get().bind_buffer_range(target, index, id, offset, size);
    }
 
    void Buffer::unbind_indexed(GLenum target, unsigned index)
    {
-      glBindBufferBase(target, index, 0);
+      State::get().bind_buffer_range(target, index, 0);
    }
 
    void Buffer::bind(GLenum target)
    {
-      glBindBuffer(target, id);
+      State::get().bind_buffer(target, id);
    }
 
    void Buffer::unbind(GLenum target)
    {
-      glBindBuffer(target, 0);
+      State::get().bind_buffer(target, 0);
    }
 
    void Buffer::bind()
    {
       if (is_indexed(target))
-         glBindBufferBase(target, index, id);
+         bind_indexed(target, index);
       else
-         glBindBuffer(target, id);
+         State::get().bind_buffer(target, id);
    }
 
    void Buffer::unbind()
    {
       if (is_indexed(target))
-         glBindBufferBase(target, index, 0);
+         State::get().bind_buffer_range(target, index, 0);
       else
-         glBindBuffer(target, 0);
+         State::get().bind_buffer(target, 0);
    }
 
    GLenum Buffer::gl_usage_from_flags(GLuint flags)
@@ -102,15 +194,165 @@ namespace GL
          case WriteOnly: return GL_DYNAMIC_DRAW;
          case ReadOnly: return GL_DYNAMIC_READ;
          case Copy: return GL_DYNAMIC_COPY;
+         case Stream: return GL_STREAM_DRAW;
          default: return GL_STATIC_DRAW;
       }
    }
 
    void Buffer::init_buffer(const void *initial_data)
    {
-      glBindBuffer(target, id);
-      glBufferData(target, size, initial_data, gl_usage_from_flags(flags));
-      glBindBuffer(target, 0);
+      // Immutable storage cannot be respecified, start over with a fresh name.
+      if (stream_stride)
+      {
+         deinit_stream();
+         glDeleteBuffers(1, &id);
+         State::get().deleted_buffer(id);
+         create_buffer();
+      }
+
+      if (flags == Stream)
+      {
+         init_stream(initial_data);
+         return;
+      }
+
+      buffer_data(size, initial_data);
+   }
+
+   void Buffer::create_buffer()
+   {
+      // Names from glCreateBuffers are backed by an object right away,
+      // so they can be edited without ever binding them.
+      if (context_caps().direct_state_access)
+         glCreateBuffers(1, &id);
+      else
+         glGenBuffers(1, &id);
+   }
+
+   void Buffer::buffer_data(GLsizeiptr size, const void *data)
+   {
+      if (context_caps().direct_state_access)
+         glNamedBufferData(id, size, data, gl_usage_from_flags(flags));
+      else
+      {
+         State::get().bind_buffer(target, id);
+         glBufferData(target, size, data, gl_usage_from_flags(flags));
+         State::get().bind_buffer(target, 0);
+      }
+   }
+
+   void Buffer::buffer_storage(GLsizeiptr size, GLbitfield flags)
+   {
+      if (context_caps().direct_state_access)
+         glNamedBufferStorage(id, size, nullptr, flags);
+      else
+      {
+         State::get().bind_buffer(target, id);
+         glBufferStorage(target, size, nullptr, flags);
+         State::get().bind_buffer(target, 0);
+      }
+   }
+
+   void *Buffer::map_range(GLintptr offset, GLsizeiptr length, GLbitfield access)
+   {
+      if (context_caps().direct_state_access)
+         return glMapNamedBufferRange(id, offset, length, access);
+
+      // A mapping belongs to the buffer object, not the binding.
+      State::get().bind_buffer(target, id);
+      void *ptr = glMapBufferRange(target, offset, length, access);
+      State::get().bind_buffer(target, 0);
+      return ptr;
+   }
+
+   void Buffer::unmap_buffer()
+   {
+      if (context_caps().direct_state_access)
+         glUnmapNamedBuffer(id);
+      else
+      {
+         State::get().bind_buffer(target, id);
+         glUnmapBuffer(target);
+         State::get().bind_buffer(target, 0);
+      }
+   }
+
+   void Buffer::init_stream(const void *initial_data)
+   {
+      auto& caps = ContextManager::get().caps();
+      GLsizeiptr alignment = target == GL_SHADER_STORAGE_BUFFER ?
+         caps.storage_buffer_alignment : caps.uniform_buffer_alignment;
+      stream_stride = (size + alignment - 1) / alignment * alignment;
+      GLsizeiptr total_size = stream_stride * (stream_frames + 1);
+
+      if (caps.buffer_storage)
+      {
+         GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+         buffer_storage(total_size, access);
+         stream_ptr = static_cast<uint8_t*>(map_range(0, total_size, access));
+         if (!stream_ptr)
+            throw std::runtime_error("Failed to map stream buffer.");
+      }
+      else
+         buffer_data(total_size, nullptr);
+
+      if (initial_data)
+      {
+         if (stream_ptr)
+            std::memcpy(stream_ptr, initial_data, size);
+         else
+            update(0, size, initial_data);
+      }
+   }
+
+   void Buffer::deinit_stream()
+   {
+      for (auto& fence : stream_fences)
+      {
+         if (fence)
+            glDeleteSync(fence);
+         fence = nullptr;
+      }
+
+      stream_stride = 0;
+      stream_offset = 0;
+      stream_slot = 0;
+      stream_ptr = nullptr;
+      stream_mapped = false;
+   }
+
+   void *Buffer::map_stream()
+   {
+      // Anything that used the current slice has been submitted by now,
+      // later draws will bind the slice we are about to hand out.
+      stream_fences[stream_slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      stream_slot = (stream_slot + 1) % (stream_frames + 1);
+      stream_offset = stream_slot * stream_stride;
+
+      GLsync& fence = stream_fences[stream_slot];
+      if (fence)
+      {
+         GLbitfield wait_flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+         GLenum result;
+         do
+         {
+            result = glClientWaitSync(fence, wait_flags, stream_wait_timeout);
+            wait_flags = 0;
+         } while (result == GL_TIMEOUT_EXPIRED);
+
+         glDeleteSync(fence);
+         fence = nullptr;
+      }
+
+      if (stream_ptr)
+         return stream_ptr + stream_offset;
+
+      // Without persistent mappings, map just this slice. The fence above
+      // already guarantees the GPU is done with it.
+      void *ptr = map_range(stream_offset, size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+      stream_mapped = ptr != nullptr;
+      return ptr;
    }
 }
 
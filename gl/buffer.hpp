@@ -5,11 +5,14 @@
 #include <stdexcept>
 #include <cstring>
 #include <type_traits>
+#include <functional>
 
 namespace GL
 {
    class Buffer : public ContextListener, public ContextResource
    {
+      friend class VertexArray;
+
       public:
          Buffer() { ContextListener::init(); }
          ~Buffer() { deinit(); }
@@ -18,9 +21,16 @@ namespace GL
             None = 0,
             WriteOnly = 1,
             ReadOnly = 2,
-            Copy = 3
+            Copy = 3,
+
+            // Write-only ring of per-frame slices. Every map() hands out the next
+            // slice and bind() binds only that slice, so updates never orphan or
+            // stall as long as the GPU is less than stream_frames behind.
+            Stream = 4
          };
 
+         enum { stream_frames = 3 };
+
          void init(GLenum target, GLsizei size, GLuint flags, const void *initial_data = nullptr, GLuint index = 0);
 
          template<typename T>
@@ -29,6 +39,13 @@ namespace GL
             init(target, t.size() * sizeof(typename T::value_type), flags, t.data(), index);
          }
 
+         // Writes size bytes of buffer contents to data.
+         using Generator = std::function<void (void *data, GLsizei size)>;
+
+         // Keeps no CPU copy of the contents. The generator runs on every
+         // upload, including after context loss.
+         void init_generated(GLenum target, GLsizei size, GLuint flags, Generator generator, GLuint index = 0);
+
          void reset() override;
          void destroyed() override;
 
@@ -38,10 +55,9 @@ namespace GL
                if (!size || !id || flags == None)
                   return false;
 
-               glBindBuffer(target, id);
-               void *ptr = glMapBufferRange(target, 0, size, flags == WriteOnly ? (GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT) : GL_MAP_READ_BIT);
+               void *ptr = flags == Stream ? map_stream() : map_range(0, size,
+                     flags == WriteOnly ? (GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT) : GL_MAP_READ_BIT);
                data = reinterpret_cast<T*>(ptr);
-               glBindBuffer(target, 0);
                return ptr != nullptr;
             }
 
@@ -50,10 +66,20 @@ namespace GL
          void unbind();
 
          void bind_indexed(GLenum target, unsigned index);
+         void bind_indexed(GLenum target, unsigned index, GLintptr offset, GLsizeiptr size);
          void unbind_indexed(GLenum target, unsigned index);
          void bind(GLenum target);
          void unbind(GLenum target);
 
+         // Zeroes part of the buffer on the GPU. Offset and size must be multiples of 4.
+         void clear(GLintptr offset, GLsizeiptr size);
+
+         // Updates part of the GL buffer only, the shadow copy is left alone.
+         void update(GLintptr offset, GLsizeiptr size, const void *data);
+
+         // Byte offset of the slice last handed out by map() for Stream buffers.
+         GLintptr offset() const { return stream_offset; }
+
       private:
          bool alive = false;
          GLenum target = 0;
@@ -62,13 +88,52 @@ namespace GL
          GLuint id = 0;
          GLsizei size = 0;
 
+         // Shadow copy of the contents for re-upload, empty with a generator.
          std::vector<uint8_t> temp;
+         Generator generator;
+
+         void fill_buffer();
+
+         // Stream state. The slice size is rounded up to the binding alignment.
+         GLsizeiptr stream_stride = 0;
+         GLintptr stream_offset = 0;
+         unsigned stream_slot = 0;
+         uint8_t *stream_ptr = nullptr;
+         bool stream_mapped = false;
+         GLsync stream_fences[stream_frames + 1] = {};
+
+         void *map_stream();
+         void init_stream(const void *initial_data);
+         void deinit_stream();
+
+         // Bind-to-edit wrappers, these use direct state access when available.
+         void create_buffer();
+         void buffer_data(GLsizeiptr size, const void *data);
+         void buffer_storage(GLsizeiptr size, GLbitfield flags);
+         void *map_range(GLintptr offset, GLsizeiptr length, GLbitfield access);
+         void unmap_buffer();
 
          static GLenum gl_usage_from_flags(GLuint flags);
          static bool is_indexed(GLenum type);
          void init_buffer(const void *initial_data);
 
    };
+
+   // A range of a Buffer, as handed out by BufferPool.
+   struct BufferRange
+   {
+      Buffer *buffer = nullptr;
+      GLintptr offset = 0;
+      GLsizeiptr size = 0;
+
+      explicit operator bool() const { return buffer != nullptr; }
+
+      // Offset in elements, for firstIndex, baseVertex and baseInstance of draw commands.
+      GLuint first_element(GLsizeiptr element_size) const { return GLuint(offset / element_size); }
+
+      void bind_indexed(GLenum target, unsigned index) const { buffer->bind_indexed(target, index, offset, size); }
+      void unbind_indexed(GLenum target, unsigned index) const { buffer->unbind_indexed(target, index); }
+   };
 }
 
 #endif
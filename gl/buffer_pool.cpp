@@ -0,0 +1,169 @@
+#include "buffer_pool.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace Template;
+
+namespace GL
+{
+   // No implementation has a UBO or SSBO offset alignment above this, which
+   // lets us allocate before the context (and its real alignment) exists.
+   static const GLsizeiptr max_indexed_alignment = 256;
+   static const GLsizeiptr default_vertex_alignment = 16;
+
+   static GLsizeiptr align_up(GLsizeiptr value, GLsizeiptr alignment)
+   {
+      return (value + alignment - 1) / alignment * alignment;
+   }
+
+   BufferPool::BufferPool(GLenum target, GLuint flags, GLsizeiptr block_size)
+      : target(target), flags(flags), block_size(block_size)
+   {}
+
+   GLsizeiptr BufferPool::default_alignment() const
+   {
+      auto& caps = ContextManager::get().caps();
+      switch (target)
+      {
+         case GL_UNIFORM_BUFFER:
+            return max<GLsizeiptr>(max_indexed_alignment, caps.uniform_buffer_alignment);
+         case GL_SHADER_STORAGE_BUFFER:
+            return max<GLsizeiptr>(max_indexed_alignment, caps.storage_buffer_alignment);
+         case GL_ATOMIC_COUNTER_BUFFER:
+            return max_indexed_alignment;
+         default:
+            return default_vertex_alignment;
+      }
+   }
+
+   bool BufferPool::Block::allocate(GLsizeiptr alloc_size, GLsizeiptr alignment, GLintptr& offset)
+   {
+      // Best fit, the smallest free range that fits wastes the least.
+      auto best = end(free_ranges);
+      for (auto itr = begin(free_ranges); itr != end(free_ranges); ++itr)
+      {
+         GLintptr start = align_up(itr->first, alignment);
+         if (start + alloc_size > itr->first + itr->second)
+            continue;
+         if (best == end(free_ranges) || itr->second < best->second)
+            best = itr;
+      }
+
+      if (best == end(free_ranges))
+         return false;
+
+      GLintptr range_start = best->first;
+      GLintptr range_end = best->first + best->second;
+      offset = align_up(range_start, alignment);
+      free_ranges.erase(best);
+
+      // Give back the alignment padding in front and the tail.
+      if (offset > range_start)
+         free_ranges[range_start] = offset - range_start;
+      if (offset + alloc_size < range_end)
+         free_ranges[offset + alloc_size] = range_end - (offset + alloc_size);
+      return true;
+   }
+
+   void BufferPool::Block::free(GLintptr offset, GLsizeiptr free_size)
+   {
+      auto inserted = free_ranges.insert({offset, free_size});
+      if (!inserted.second)
+         throw logic_error("Double free of buffer range.");
+      auto itr = inserted.first;
+
+      auto next = std::next(itr);
+      if (next != end(free_ranges) && itr->first + itr->second == next->first)
+      {
+         itr->second += next->second;
+         free_ranges.erase(next);
+      }
+
+      if (itr != begin(free_ranges))
+      {
+         auto prev = std::prev(itr);
+         if (prev->first + prev->second == itr->first)
+         {
+            prev->second += itr->second;
+            free_ranges.erase(itr);
+         }
+      }
+   }
+
+   BufferPool::Block& BufferPool::create_block(GLsizeiptr min_size)
+   {
+      blocks.emplace_back(new Block);
+      auto& block = *blocks.back();
+      block.size = max(block_size, min_size);
+      block.free_ranges[0] = block.size;
+
+      // Only allocations with data are shadowed, anything else comes back zeroed.
+      auto *shadow = &block.shadow;
+      block.buffer.init_generated(target, block.size, flags, [shadow](void *data, GLsizei size) {
+         memcpy(data, shadow->data(), shadow->size());
+         memset(static_cast<uint8_t*>(data) + shadow->size(), 0, size - shadow->size());
+      });
+
+      return block;
+   }
+
+   BufferRange BufferPool::allocate(GLsizeiptr size, const void *data, GLsizeiptr alignment)
+   {
+      if (size <= 0)
+         throw logic_error("Empty buffer range.");
+
+      if (!alignment)
+         alignment = default_alignment();
+
+      Block *block = nullptr;
+      GLintptr offset = 0;
+      for (auto& candidate : blocks)
+      {
+         if (candidate->allocate(size, alignment, offset))
+         {
+            block = candidate.get();
+            break;
+         }
+      }
+
+      if (!block)
+      {
+         block = &create_block(size + alignment);
+         if (!block->allocate(size, alignment, offset))
+            throw logic_error("Failed to allocate from fresh buffer block.");
+      }
+
+      if (data)
+      {
+         // The shadow only covers the block up to the last range written.
+         if (block->shadow.size() < size_t(offset + size))
+            block->shadow.resize(offset + size);
+         memcpy(block->shadow.data() + offset, data, size);
+         block->buffer.update(offset, size, data);
+      }
+
+      BufferRange range;
+      range.buffer = &block->buffer;
+      range.offset = offset;
+      range.size = size;
+      return range;
+   }
+
+   void BufferPool::free(const BufferRange& range)
+   {
+      auto& block = find_if_or_throw(blocks, [&range](const unique_ptr<Block>& block) {
+         return &block->buffer == range.buffer;
+      });
+      block->free(range.offset, range.size);
+   }
+
+   GLsizeiptr BufferPool::capacity() const
+   {
+      GLsizeiptr total = 0;
+      for (auto& block : blocks)
+         total += block->size;
+      return total;
+   }
+}
+
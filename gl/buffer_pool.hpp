@@ -0,0 +1,68 @@
+#ifndef BUFFER_POOL_HPP__
+#define BUFFER_POOL_HPP__
+
+#include "global.hpp"
+#include "buffer.hpp"
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace GL
+{
+   // Carves ranges out of a few large buffers, so that many small meshes and
+   // uniform blocks share buffer objects (and can share vertex arrays).
+   // Contents written through allocate() are shadowed per block and restored
+   // on context reset, same as a plain Buffer.
+   class BufferPool
+   {
+      public:
+         // Target only decides the default alignment, ranges may be bound to any target.
+         BufferPool(GLenum target, GLuint flags = Buffer::None, GLsizeiptr block_size = 4 * 1024 * 1024);
+
+         BufferPool(const BufferPool&) = delete;
+         void operator=(const BufferPool&) = delete;
+
+         // An alignment of 0 picks the default for the pool's target.
+         // Alignment does not have to be a power of two, so vertex data can
+         // be aligned to its stride and addressed with baseVertex.
+         BufferRange allocate(GLsizeiptr size, const void *data = nullptr, GLsizeiptr alignment = 0);
+
+         template<typename T>
+         typename std::enable_if<sizeof(typename T::value_type) != 0, BufferRange>::type
+         allocate(const T& t, GLsizeiptr alignment = 0)
+         {
+            return allocate(t.size() * sizeof(typename T::value_type), t.data(), alignment);
+         }
+
+         void free(const BufferRange& range);
+
+         // Total bytes of GL buffer storage owned by the pool.
+         GLsizeiptr capacity() const;
+         size_t num_buffers() const { return blocks.size(); }
+
+      private:
+         struct Block
+         {
+            Buffer buffer;
+            GLsizeiptr size = 0;
+            std::vector<uint8_t> shadow; // Up to the end of the last range written.
+
+            // Free ranges, offset -> size. Neighbours are always merged.
+            std::map<GLintptr, GLsizeiptr> free_ranges;
+
+            bool allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset);
+            void free(GLintptr offset, GLsizeiptr size);
+         };
+
+         GLenum target;
+         GLuint flags;
+         GLsizeiptr block_size;
+         std::vector<std::unique_ptr<Block>> blocks;
+
+         GLsizeiptr default_alignment() const;
+         Block& create_block(GLsizeiptr min_size);
+   };
+}
+
+#endif
+
@@ -6,6 +6,12 @@ namespace GL
 {
    void Renderbuffer::allocate()
    {
+      if (context_caps().direct_state_access)
+      {
+         glNamedRenderbufferStorageMultisample(id, samples, internal_format, width, height);
+         return;
+      }
+
       glBindRenderbuffer(GL_RENDERBUFFER, id);
       glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, internal_format, width, height);
       glBindRenderbuffer(GL_RENDERBUFFER, 0);
@@ -23,7 +29,10 @@ namespace GL
 
    void Renderbuffer::reset()
    {
-      glGenRenderbuffers(1, &id);
+      if (context_caps().direct_state_access)
+         glCreateRenderbuffers(1, &id);
+      else
+         glGenRenderbuffers(1, &id);
       if (internal_format)
          allocate();
    }
@@ -40,7 +49,10 @@ namespace GL
 
    void Framebuffer::reset()
    {
-      glGenFramebuffers(1, &id);
+      if (context_caps().direct_state_access)
+         glCreateFramebuffers(1, &id);
+      else
+         glGenFramebuffers(1, &id);
       bind_all();
    }
 
@@ -98,6 +110,12 @@ namespace GL
       if (textures.empty() && renderbuffers.empty())
          return;
 
+      if (context_caps().direct_state_access)
+      {
+         attach_direct();
+         return;
+      }
+
       push();
       glBindFramebuffer(GL_FRAMEBUFFER, id);
       attachments.clear();
@@ -150,6 +168,51 @@ namespace GL
       pop();
    }
 
+   void Framebuffer::attach_direct()
+   {
+      attachments.clear();
+
+      for (auto& tex : textures)
+      {
+         auto& desc = tex.tex->get_desc();
+         GLenum attachment = format_to_attachment(desc.internal_format, tex.color_index);
+         attachments.push_back(attachment);
+
+         switch (desc.type)
+         {
+            case Texture::Texture1D:
+            case Texture::Texture1DArray:
+               throw runtime_error("Attaching 1D textures not supported!");
+
+            case Texture::Texture2D:
+               glNamedFramebufferTexture(id, attachment, tex.tex->id, tex.level);
+               break;
+
+            // Cube faces are layers of the cube map here.
+            case Texture::TextureCube:
+            case Texture::Texture2DArray:
+               glNamedFramebufferTextureLayer(id, attachment, tex.tex->id, tex.level, tex.layer);
+               break;
+
+            default:
+               throw runtime_error("Attaching invalid texture type!");
+         }
+      }
+
+      for (auto& buffer : renderbuffers)
+      {
+         GLenum attachment = format_to_attachment(buffer.buffer->internal_format, buffer.color_index);
+         attachments.push_back(attachment);
+
+         glNamedFramebufferRenderbuffer(id, attachment, GL_RENDERBUFFER, buffer.buffer->id);
+      }
+
+      glNamedFramebufferDrawBuffers(id, color_attachments.size(), color_attachments.data());
+
+      if (glCheckNamedFramebufferStatus(id, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+         throw runtime_error("Framebuffer is not complete!");
+   }
+
    void Framebuffer::destroyed()
    {
       glDeleteFramebuffers(1, &id);
@@ -198,6 +261,13 @@ namespace GL
 
    void Framebuffer::blit(GLuint fb, unsigned width, unsigned height, unsigned mask)
    {
+      if (context_caps().direct_state_access)
+      {
+         glBlitNamedFramebuffer(id, fb, 0, 0, width, height, 0, 0, width, height, mask,
+               GL_NEAREST);
+         return;
+      }
+
       push();
       glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fb);
       glBindFramebuffer(GL_READ_FRAMEBUFFER, id);
@@ -227,6 +297,12 @@ namespace GL
 
    void Framebuffer::invalidate()
    {
+      if (context_caps().direct_state_access)
+      {
+         glInvalidateNamedFramebufferData(id, attachments.size(), attachments.data());
+         return;
+      }
+
       push();
       glBindFramebuffer(GL_FRAMEBUFFER, id);
       glInvalidateFramebuffer(GL_FRAMEBUFFER, attachments.size(), attachments.data());
@@ -86,6 +86,7 @@ namespace GL
          std::vector<GLenum> attachments;
 
          void bind_all();
+         void attach_direct();
 
          static GLenum format_to_attachment(GLenum format, unsigned color_index);
          static bool format_is_color(GLenum format);
@@ -1,6 +1,8 @@
 #include "global.hpp"
+#include "state.hpp"
 #include <memory>
 #include <algorithm>
+#include <cstring>
 
 using namespace std;
 using namespace Template;
@@ -167,8 +169,78 @@ namespace GL
       erase_all(listeners, itr);
    }
 
+   bool Capabilities::has_version(unsigned major, unsigned minor) const
+   {
+      return this->major > major || (this->major == major && this->minor >= minor);
+   }
+
+   bool Capabilities::has_extension(const char *ext)
+   {
+      GLint num_extensions = 0;
+      glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+      for (GLint i = 0; i < num_extensions; i++)
+      {
+         auto name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+         if (name && !strcmp(name, ext))
+            return true;
+      }
+      return false;
+   }
+
+   void ContextManager::query_capabilities()
+   {
+      capabilities = Capabilities();
+
+      GLint major = 0, minor = 0;
+      glGetIntegerv(GL_MAJOR_VERSION, &major);
+      glGetIntegerv(GL_MINOR_VERSION, &minor);
+      capabilities.major = major;
+      capabilities.minor = minor;
+
+      glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &capabilities.uniform_buffer_alignment);
+      glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &capabilities.storage_buffer_alignment);
+
+      capabilities.buffer_storage = glBufferStorage &&
+         (capabilities.has_version(4, 4) || Capabilities::has_extension("GL_ARB_buffer_storage"));
+
+      capabilities.direct_state_access = glCreateBuffers && glCreateTextures && glCreateVertexArrays &&
+         (capabilities.has_version(4, 5) || Capabilities::has_extension("GL_ARB_direct_state_access"));
+
+      GLint binary_formats = 0;
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+      capabilities.program_binary = glGetProgramBinary && glProgramBinary && binary_formats > 0;
+
+      capabilities.parallel_shader_compile = Capabilities::has_extension("GL_KHR_parallel_shader_compile") ||
+         Capabilities::has_extension("GL_ARB_parallel_shader_compile");
+
+      if (Capabilities::has_extension("GL_KHR_shader_subgroup"))
+      {
+         GLint stages = 0, features = 0;
+         glGetIntegerv(GL_SUBGROUP_SUPPORTED_STAGES_KHR, &stages);
+         glGetIntegerv(GL_SUBGROUP_SUPPORTED_FEATURES_KHR, &features);
+         capabilities.subgroup_stages = stages;
+         capabilities.subgroup_features = features;
+      }
+
+      for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+      {
+         auto str = reinterpret_cast<const char*>(glGetString(name));
+         capabilities.driver += str ? str : "";
+         capabilities.driver += '\n';
+      }
+
+      log("GL %u.%u, buffer storage: %s, direct state access: %s, program binary: %s, parallel compile: %s.",
+            capabilities.major, capabilities.minor,
+            capabilities.buffer_storage ? "yes" : "no",
+            capabilities.direct_state_access ? "yes" : "no",
+            capabilities.program_binary ? "yes" : "no",
+            capabilities.parallel_shader_compile ? "yes" : "no");
+   }
+
    void ContextManager::notify_reset()
    {
+      State::get().invalidate();
+      query_capabilities();
       alive = true;
       for (auto& state : listeners)
          state->reset_chain();
@@ -179,6 +251,7 @@ namespace GL
       for (auto& state : listeners)
          state->destroy_chain();
       alive = false;
+      State::get().invalidate();
    }
 
    void ContextManager::ListenerState::reset_chain()
@@ -82,6 +82,26 @@ namespace GL
          bool dead_manager = false;
    };
 
+   // Optional features of the current context, queried on every context reset.
+   struct Capabilities
+   {
+      unsigned major = 0;
+      unsigned minor = 0;
+      GLint uniform_buffer_alignment = 256;
+      GLint storage_buffer_alignment = 256;
+      bool buffer_storage = false;
+      bool direct_state_access = false;
+      bool program_binary = false;
+      bool parallel_shader_compile = false;
+      // GL_KHR_shader_subgroup, both 0 without it.
+      GLbitfield subgroup_stages = 0;
+      GLbitfield subgroup_features = 0;
+      std::string driver; // Vendor, renderer and version strings.
+
+      bool has_version(unsigned major, unsigned minor) const;
+      static bool has_extension(const char *ext);
+   };
+
    class ContextManager
    {
       public:
@@ -96,6 +116,8 @@ namespace GL
          void register_dependency(ContextListener *master, ContextListener *slave);
          void unregister_dependency(ContextListener *master, ContextListener *slave);
 
+         const Capabilities& caps() const { return capabilities; }
+
          void set_dir(const std::string& dir) { libretro_dir = dir; }
          inline std::string path(const std::string& p)
          {
@@ -129,6 +151,8 @@ namespace GL
          bool alive = false;
 
          uint64_t context_id = 0;
+         Capabilities capabilities;
+         void query_capabilities();
 
          std::string libretro_dir;
    };
@@ -138,6 +162,11 @@ namespace GL
       return ContextManager::get().path(path);
    }
 
+   inline const Capabilities& context_caps()
+   {
+      return ContextManager::get().caps();
+   }
+
    // Non-copyable, non-movable stubs.
    class ContextResource
    {
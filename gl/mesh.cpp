@@ -1,41 +1,252 @@
 #include "mesh.hpp"
 #include "shader.hpp"
-#include <set>
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <system_error>
+#include <exception>
 
 using namespace std;
 using namespace glm;
 
 namespace GL
 {
-   template<typename T>
-   inline T parse_line(const string& data);
+   // Non-owning view into a memory mapped OBJ/MTL file.
+   struct Token
+   {
+      const char *begin = nullptr;
+      const char *end = nullptr;
 
-   template<>
-   inline vec2 parse_line(const string& data)
+      Token() = default;
+      Token(const char *begin, const char *end) : begin(begin), end(end) {}
+
+      bool empty() const { return begin == end; }
+      size_t size() const { return end - begin; }
+      string str() const { return string(begin, end); }
+
+      template<size_t N>
+      bool is(const char (&literal)[N]) const
+      {
+         return size() == N - 1 && !memcmp(begin, literal, N - 1);
+      }
+   };
+
+   static inline bool is_space(char c)
    {
-      float x = 0, y = 0;
-      vector<string> split = String::split(data, " ");
-      if (split.size() >= 2)
+      return c == ' ' || c == '\t' || c == '\r';
+   }
+
+   static inline bool is_digit(char c)
+   {
+      return c >= '0' && c <= '9';
+   }
+
+   static Token strip(Token tok)
+   {
+      while (tok.begin < tok.end && is_space(*tok.begin))
+         tok.begin++;
+      while (tok.end > tok.begin && is_space(tok.end[-1]))
+         tok.end--;
+      return tok;
+   }
+
+   // Returns lines one at a time, stripped of surrounding whitespace.
+   static bool next_line(const char *&ptr, const char *end, Token& line)
+   {
+      if (ptr >= end)
+         return false;
+
+      auto newline = static_cast<const char*>(memchr(ptr, '\n', end - ptr));
+      const char *line_end = newline ? newline : end;
+      line = strip({ptr, line_end});
+      ptr = newline ? newline + 1 : end;
+      return true;
+   }
+
+   // Pulls the next whitespace separated token out of data.
+   static bool next_token(Token& data, Token& tok)
+   {
+      const char *p = data.begin;
+      while (p < data.end && (*p == ' ' || *p == '\t'))
+         p++;
+      if (p == data.end)
       {
-         x = stof(split[0]);
-         y = stof(split[1]);
+         data.begin = p;
+         return false;
       }
 
-      return vec2(x, y);
+      const char *start = p;
+      while (p < data.end && *p != ' ' && *p != '\t')
+         p++;
+
+      tok = {start, p};
+      data.begin = p;
+      return true;
    }
 
-   template<>
-   inline vec3 parse_line(const string& data)
+   // Splits "type data" where data is the rest of the line.
+   static void split_line(const Token& line, Token& type, Token& data)
+   {
+      const char *p = line.begin;
+      while (p < line.end && *p != ' ' && *p != '\t')
+         p++;
+
+      type = {line.begin, p};
+      data = strip({p, line.end});
+   }
+
+   static float parse_float_slow(const char *begin, const char *end, const char *&parse_end)
+   {
+      // Rare path (huge mantissas, inf/nan, hex floats). strtof() needs a terminated string.
+      char buf[128];
+      size_t len = std::min<size_t>(end - begin, sizeof(buf) - 1);
+      memcpy(buf, begin, len);
+      buf[len] = '\0';
+
+      char *buf_end = nullptr;
+      float value = strtof(buf, &buf_end);
+      parse_end = begin + (buf_end - buf);
+      return value;
+   }
+
+   // Non-allocating equivalent of stof() for the common OBJ number formats.
+   // Mantissas which fit exactly in a double with a small power-of-ten
+   // exponent are scaled with one correctly rounded double operation.
+   // Rounding that to float again only goes wrong if the double landed
+   // exactly on the midpoint between two floats, those and everything else
+   // are deferred to strtof(), so results match it bit for bit.
+   static float parse_float(const Token& tok)
+   {
+      static const double pow10[] = {
+         1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+      };
+
+      const char *p = tok.begin;
+      const char *end = tok.end;
+
+      bool negative = false;
+      if (p < end && (*p == '-' || *p == '+'))
+         negative = *p++ == '-';
+
+      uint64_t mantissa = 0;
+      int digits = 0;
+      int exponent = 0;
+      bool seen_digit = false;
+
+      for (; p < end && is_digit(*p); p++)
+      {
+         seen_digit = true;
+         if (digits < 19)
+         {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa)
+               digits++;
+         }
+         else
+            exponent++;
+      }
+
+      if (p < end && *p == '.')
+      {
+         for (p++; p < end && is_digit(*p); p++)
+         {
+            seen_digit = true;
+            if (digits < 19)
+            {
+               mantissa = mantissa * 10 + (*p - '0');
+               if (mantissa)
+                  digits++;
+               exponent--;
+            }
+         }
+      }
+
+      if (p < end && (*p == 'e' || *p == 'E'))
+      {
+         const char *e = p + 1;
+         bool exp_negative = false;
+         if (e < end && (*e == '-' || *e == '+'))
+            exp_negative = *e++ == '-';
+
+         if (e < end && is_digit(*e))
+         {
+            int exp_value = 0;
+            for (; e < end && is_digit(*e); e++)
+               if (exp_value < 10000)
+                  exp_value = exp_value * 10 + (*e - '0');
+            exponent += exp_negative ? -exp_value : exp_value;
+            p = e;
+         }
+      }
+
+      bool hex = p < end && (*p == 'x' || *p == 'X');
+      if (seen_digit && !hex && digits <= 15 && exponent >= -22 && exponent <= 22)
+      {
+         double value = double(mantissa);
+         if (exponent < 0)
+            value /= pow10[-exponent];
+         else
+            value *= pow10[exponent];
+
+         // Normal floats keep the upper 24 of the double's 53 mantissa bits,
+         // a midpoint has only the highest of the other 29 bits set.
+         uint64_t bits;
+         memcpy(&bits, &value, sizeof(bits));
+         bool midpoint = (bits & ((uint64_t(1) << 29) - 1)) == (uint64_t(1) << 28);
+         if (value == 0.0 || (value >= FLT_MIN && value <= FLT_MAX && !midpoint))
+            return float(negative ? -value : value);
+      }
+
+      const char *parse_end = nullptr;
+      float value = parse_float_slow(tok.begin, end, parse_end);
+      if (parse_end == tok.begin)
+         throw runtime_error(String::cat("Invalid number: ", tok.str()));
+      return value;
+   }
+
+   // Non-allocating equivalent of stoi().
+   static int parse_int(const Token& tok)
    {
-      float x = 0, y = 0, z = 0;
-      vector<string> split = String::split(data, " ");
-      if (split.size() >= 3)
+      const char *p = tok.begin;
+      bool negative = false;
+      if (p < tok.end && (*p == '-' || *p == '+'))
+         negative = *p++ == '-';
+
+      if (p == tok.end || !is_digit(*p))
+         throw runtime_error(String::cat("Invalid index: ", tok.str()));
+
+      int64_t value = 0;
+      for (; p < tok.end && is_digit(*p); p++)
       {
-         x = stof(split[0]);
-         y = stof(split[1]);
-         z = stof(split[2]);
+         value = value * 10 + (*p - '0');
+         if (value > numeric_limits<int>::max())
+            throw runtime_error(String::cat("Index out of range: ", tok.str()));
       }
-      return vec3(x, y, z);
+
+      return int(negative ? -value : value);
+   }
+
+   template<typename T>
+   inline T parse_line(Token data);
+
+   template<>
+   inline vec2 parse_line(Token data)
+   {
+      Token x, y;
+      if (next_token(data, x) && next_token(data, y))
+         return vec2(parse_float(x), parse_float(y));
+      return vec2(0.0f);
+   }
+
+   template<>
+   inline vec3 parse_line(Token data)
+   {
+      Token x, y, z;
+      if (next_token(data, x) && next_token(data, y) && next_token(data, z))
+         return vec3(parse_float(x), parse_float(y), parse_float(z));
+      return vec3(0.0f);
    }
 
    inline size_t translate_index(int index, size_t size)
@@ -47,192 +258,695 @@ namespace GL
    {
       map<string, Material> materials;
 
-      ifstream file(asset_path(path).c_str(), ios::in);
-      if (!file.is_open())
+      File::MappedFile file;
+      if (!file.open(asset_path(path)))
          throw runtime_error(String::cat("Failed to open mtllib: ", path));
 
       Material current;
       string current_mtl;
 
-      for (string line; getline(file, line); )
+      const char *ptr = file.data();
+      const char *end = ptr + file.size();
+
+      Token line, type, data;
+      while (next_line(ptr, end, line))
       {
-         line = String::strip(line);
-         size_t split_point = line.find_first_of(' ');
-         string type = line.substr(0, split_point);
-         string data = split_point != string::npos ? line.substr(split_point + 1) : string();
+         split_line(line, type, data);
 
-         if (type == "newmtl")
+         if (type.is("newmtl"))
          {
             if (!current_mtl.empty())
                materials[current_mtl] = current;
 
             current = Material();
-            current_mtl = data;
+            current_mtl = data.str();
          }
-         else if (type == "Ka")
+         else if (type.is("Ka"))
             current.ambient = parse_line<vec3>(data);
-         else if (type == "Kd")
+         else if (type.is("Kd"))
             current.diffuse = parse_line<vec3>(data);
-         else if (type == "Ks")
+         else if (type.is("Ks"))
             current.specular = parse_line<vec3>(data);
-         else if (type == "Ns")
-            current.specular_power = stof(data);
-         else if (type == "map_Kd")
-            current.diffuse_map = Path::join(Path::basedir(path), data);
+         else if (type.is("Ns"))
+            current.specular_power = parse_float(data);
+         else if (type.is("map_Kd"))
+            current.diffuse_map = Path::join(Path::basedir(path), data.str());
       }
 
       materials[current_mtl] = current;
       return materials;
    }
 
-   void Mesh::finalize()
+   unsigned Mesh::vertex_stride() const
+   {
+      unsigned stride = 0;
+      if (has_vertex)
+         stride += 3;
+      if (has_normal)
+         stride += 3;
+      if (has_texcoord)
+         stride += 2;
+      return stride;
+   }
+
+   static uint32_t pack_snorm_2_10_10_10(const vec3& v)
    {
+      auto pack = [](float f) {
+         return uint32_t(int32_t(round(clamp(f, -1.0f, 1.0f) * 511.0f))) & 0x3ff;
+      };
+      return pack(v.x) | (pack(v.y) << 10) | (pack(v.z) << 20);
+   }
+
+   static uint16_t pack_unorm16(float f)
+   {
+      return uint16_t(round(clamp(f, 0.0f, 1.0f) * 65535.0f));
+   }
+
+   static uint16_t pack_half(float f)
+   {
+      return uint16_t(packHalf2x16(vec2(f, 0.0f)) & 0xffff);
+   }
+
+   void Mesh::finalize(unsigned quantization)
+   {
+      if ((quantization & QuantizePositionHalf) && (quantization & QuantizePositionUnorm16))
+         throw logic_error("Positions can only be quantized to one format.");
+
+      this->quantization = quantization;
       arrays.clear();
+      packed_vbo.clear();
+      packed_ibo.clear();
+      index_type = GL_UNSIGNED_INT;
+
       GLsizei offset = 0;
+      auto add_array = [&](GLuint location, GLint size, GLenum type, GLboolean normalized, GLsizei bytes) {
+         arrays.push_back({ location, size, type, normalized, 0, 0, 0, offset });
+         offset += bytes;
+      };
+
+      // Quantized positions are padded to 8 bytes to keep attributes 4 byte aligned.
       if (has_vertex)
       {
-         arrays.push_back({ Shader::VertexLocation, 3, GL_FLOAT, GL_FALSE, 0, 0, 0, offset});
-         offset += 3 * sizeof(float);
+         if (quantization & QuantizePositionHalf)
+            add_array(Shader::VertexLocation, 3, GL_HALF_FLOAT, GL_FALSE, 4 * sizeof(uint16_t));
+         else if (quantization & QuantizePositionUnorm16)
+            add_array(Shader::VertexLocation, 3, GL_UNSIGNED_SHORT, GL_TRUE, 4 * sizeof(uint16_t));
+         else
+            add_array(Shader::VertexLocation, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float));
       }
 
       if (has_normal)
       {
-         arrays.push_back({ Shader::NormalLocation, 3, GL_FLOAT, GL_FALSE, 0, 0, 0, offset});
-         offset += 3 * sizeof(float);
+         if (quantization & QuantizeNormal)
+            add_array(Shader::NormalLocation, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(uint32_t));
+         else
+            add_array(Shader::NormalLocation, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float));
       }
 
       if (has_texcoord)
       {
-         arrays.push_back({ Shader::TexCoordLocation, 2, GL_FLOAT, GL_FALSE, 0, 0, 0, offset});
-         offset += 2 * sizeof(float);
+         if (quantization & QuantizeTexCoord)
+            add_array(Shader::TexCoordLocation, 2, GL_HALF_FLOAT, GL_FALSE, 2 * sizeof(uint16_t));
+         else
+            add_array(Shader::TexCoordLocation, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float));
       }
 
       for (auto& array : arrays)
          array.stride = offset;
+
+      unsigned stride = vertex_stride();
+      size_t num_vertices = stride ? vbo.size() / stride : 0;
+
+      if (quantization & (QuantizePositionHalf | QuantizePositionUnorm16 | QuantizeNormal | QuantizeTexCoord))
+      {
+         packed_vbo.assign(num_vertices * offset, 0);
+         vec3 inv_extent;
+         for (unsigned c = 0; c < 3; c++)
+            inv_extent[c] = aabb.offset[c] > 0.0f ? 1.0f / aabb.offset[c] : 0.0f;
+
+         for (size_t i = 0; i < num_vertices; i++)
+         {
+            const float *src = &vbo[i * stride];
+            uint8_t *dst = &packed_vbo[i * offset];
+
+            for (auto& array : arrays)
+            {
+               uint8_t *attr = dst + array.offset;
+               if (array.type == GL_FLOAT)
+                  memcpy(attr, src, array.size * sizeof(float));
+               else if (array.location == Shader::VertexLocation)
+               {
+                  uint16_t packed[3];
+                  vec3 pos = make_vec3(src);
+                  for (unsigned c = 0; c < 3; c++)
+                  {
+                     packed[c] = array.type == GL_HALF_FLOAT ? pack_half(pos[c]) :
+                        pack_unorm16((pos[c] - aabb.base[c]) * inv_extent[c]);
+                  }
+                  memcpy(attr, packed, sizeof(packed));
+               }
+               else if (array.location == Shader::NormalLocation)
+               {
+                  uint32_t packed = pack_snorm_2_10_10_10(make_vec3(src));
+                  memcpy(attr, &packed, sizeof(packed));
+               }
+               else
+               {
+                  uint16_t packed[2] = { pack_half(src[0]), pack_half(src[1]) };
+                  memcpy(attr, packed, sizeof(packed));
+               }
+
+               src += array.location == Shader::TexCoordLocation ? 2 : 3;
+            }
+         }
+      }
+
+      if ((quantization & QuantizeIndices) && num_vertices <= 0x10000)
+      {
+         index_type = GL_UNSIGNED_SHORT;
+         packed_ibo.resize(ibo.size() * sizeof(uint16_t));
+         auto indices = reinterpret_cast<uint16_t*>(packed_ibo.data());
+         for (size_t i = 0; i < ibo.size(); i++)
+            indices[i] = uint16_t(ibo[i]);
+      }
+   }
+
+   void Mesh::init_buffers(Buffer& vertex_buffer, Buffer& index_buffer, GLuint flags) const
+   {
+      if (packed_vbo.empty())
+         vertex_buffer.init(GL_ARRAY_BUFFER, vbo, flags);
+      else
+         vertex_buffer.init(GL_ARRAY_BUFFER, packed_vbo, flags);
+
+      if (packed_ibo.empty())
+         index_buffer.init(GL_ELEMENT_ARRAY_BUFFER, ibo, flags);
+      else
+         index_buffer.init(GL_ELEMENT_ARRAY_BUFFER, packed_ibo, flags);
+   }
+
+   void Mesh::init_buffers(BufferPool& pool, BufferRange& vertex_range, BufferRange& index_range) const
+   {
+      GLsizeiptr vertex_size = arrays.empty() ? 0 : arrays.front().stride;
+      if (packed_vbo.empty())
+         vertex_range = pool.allocate(vbo, vertex_size);
+      else
+         vertex_range = pool.allocate(packed_vbo, vertex_size);
+
+      if (packed_ibo.empty())
+         index_range = pool.allocate(ibo, index_size());
+      else
+         index_range = pool.allocate(packed_ibo, index_size());
    }
 
-   struct Face 
+   GLsizeiptr Mesh::index_size() const
+   {
+      switch (index_type)
+      {
+         case GL_UNSIGNED_BYTE: return 1;
+         case GL_UNSIGNED_SHORT: return 2;
+         default: return 4;
+      }
+   }
+
+   mat4 Mesh::position_transform() const
+   {
+      if (!(quantization & QuantizePositionUnorm16))
+         return mat4(1.0f);
+      return translate(mat4(1.0f), aabb.base) * scale(mat4(1.0f), aabb.offset);
+   }
+
+   struct Face
    {
       int vertex = -1;
       int normal = -1;
-      int texcoord = -1; 
+      int texcoord = -1;
       unsigned buffer_index = 0;
 
-      bool operator<(const Face& other) const
+      bool operator==(const Face& other) const
       {
-         if (vertex - other.vertex)
-            return vertex < other.vertex;
-         if (normal - other.normal)
-            return normal < other.normal;
-         if (texcoord - other.texcoord)
-            return texcoord < other.texcoord;
-
-         return false;
+         return vertex == other.vertex &&
+            normal == other.normal &&
+            texcoord == other.texcoord;
       }
    };
 
-   static void parse_vertex(const string& vert,
-         set<Face>& faces,
-         Mesh& mesh,
-         const vector<vec3>& vertex,
-         const vector<vec3>& normal,
-         const vector<vec2>& tex)
+   // Open addressing (linear probing) hash table which maps a v/vt/vn triple
+   // to its index in the vertex buffer.
+   // Clearing only bumps a generation counter so the table can be reused
+   // between usemtl splits without touching memory.
+   class VertexCache
    {
-      Face face;
-      auto coords = String::split(vert, "/", true);
+      public:
+         void reserve(size_t count)
+         {
+            size_t size = 64;
+            while (size < 2 * count)
+               size <<= 1;
+
+            if (size > entries.size())
+               rehash(size);
+         }
+
+         void clear()
+         {
+            count = 0;
+            if (++generation == 0) // Wrapped around, have to clear for real.
+            {
+               fill(begin(entries), end(entries), Entry());
+               generation = 1;
+            }
+         }
+
+         size_t size() const { return count; }
+
+         // Returns true if face already exists and fills in buffer_index.
+         // Otherwise, face is inserted with buffer_index set to the current size.
+         // face_hash is hash(face), computed ahead of time by the caller.
+         bool find_or_insert(Face& face, uint32_t face_hash)
+         {
+            if (2 * (count + 1) > entries.size())
+               rehash(std::max<size_t>(64, 2 * entries.size()));
+
+            size_t mask = entries.size() - 1;
+            for (size_t i = face_hash & mask; ; i = (i + 1) & mask)
+            {
+               auto& entry = entries[i];
+               if (entry.generation != generation)
+               {
+                  face.buffer_index = count++;
+                  entry.face = face;
+                  entry.generation = generation;
+                  return false;
+               }
+               else if (entry.face == face)
+               {
+                  face.buffer_index = entry.face.buffer_index;
+                  return true;
+               }
+            }
+         }
+
+         static uint32_t hash(const Face& face)
+         {
+            uint32_t h = uint32_t(face.vertex) * 0x9e3779b1u;
+            h ^= uint32_t(face.normal) * 0x85ebca77u;
+            h ^= uint32_t(face.texcoord) * 0xc2b2ae3du;
+            h ^= h >> 16;
+            h *= 0x7feb352du;
+            h ^= h >> 15;
+            return h;
+         }
+
+      private:
+         struct Entry
+         {
+            Face face;
+            uint32_t generation = 0;
+         };
+         vector<Entry> entries;
+         size_t count = 0;
+         uint32_t generation = 1;
+
+         void rehash(size_t size)
+         {
+            vector<Entry> old(size);
+            swap(old, entries);
+
+            size_t mask = entries.size() - 1;
+            for (auto& entry : old)
+            {
+               if (entry.generation != generation)
+                  continue;
 
-      if (coords.size() == 1) // Vertex only
+               size_t i = hash(entry.face) & mask;
+               while (entries[i].generation == generation)
+                  i = (i + 1) & mask;
+               entries[i] = entry;
+            }
+         }
+   };
+
+   // Splits v/vt/vn, keeping empty entries. Returns the total number of parts.
+   static unsigned split_vertex(const Token& vert, Token *parts, unsigned max_parts)
+   {
+      unsigned count = 0;
+      const char *p = vert.begin;
+      for (;;)
       {
-         size_t coord = translate_index(stoi(coords[0]), vertex.size());
-         if (coord && vertex.size() >= coord)
-            face.vertex = coord - 1;
+         auto slash = static_cast<const char*>(memchr(p, '/', vert.end - p));
+         if (count < max_parts)
+            parts[count] = {p, slash ? slash : vert.end};
+         count++;
+
+         if (!slash)
+            return count;
+         p = slash + 1;
+      }
+   }
 
-         mesh.has_vertex = true;
+   enum class CornerFormat : uint8_t
+   {
+      Invalid,
+      Vertex,
+      VertexTexCoord,
+      VertexTexCoordNormal,
+      VertexNormal
+   };
+
+   // One v/vt/vn reference of a face with indices as written in the file.
+   struct ObjCorner
+   {
+      int vertex = 0;
+      int texcoord = 0;
+      int normal = 0;
+      CornerFormat format = CornerFormat::Invalid;
+   };
+
+   struct ObjFace
+   {
+      uint32_t first_corner;
+      uint32_t num_corners;
+
+      // Attributes seen earlier in the same chunk.
+      // Needed to resolve relative (negative) indices once chunks are merged.
+      uint32_t vertex_count;
+      uint32_t normal_count;
+      uint32_t texcoord_count;
+   };
+
+   struct ObjEvent
+   {
+      enum Type { UseMtl, MtlLib };
+      Type type;
+      size_t face; // Event happens before this face.
+      string data;
+   };
+
+   // Run of faces between usemtl statements within a chunk.
+   struct ObjSegment
+   {
+      uint32_t first_unique; // Into ObjChunk::uniques.
+      uint32_t num_uniques;
+      unsigned formats; // Bit per CornerFormat used.
+   };
+
+   // Result of parsing a line-aligned slice of an OBJ file.
+   struct ObjChunk
+   {
+      vector<vec3> vertex;
+      vector<vec3> normal;
+      vector<vec2> tex;
+      vector<ObjCorner> corners;
+      vector<ObjFace> faces;
+      vector<ObjEvent> events;
+
+      // Filled in by dedupe_chunk(). A segment starts with the chunk and at every usemtl.
+      // uniques holds the distinct corners of each segment in order of first use,
+      // corner_index maps every corner to its position within its segment.
+      vector<ObjSegment> segments;
+      vector<Face> uniques;
+      vector<uint32_t> unique_hashes;
+      vector<uint32_t> corner_index;
+
+      exception_ptr error;
+   };
+
+   static ObjCorner parse_corner(const Token& vert)
+   {
+      ObjCorner corner;
+      Token coords[3];
+      unsigned num_coords = split_vertex(vert, coords, 3);
+
+      if (num_coords == 1) // Vertex only
+      {
+         corner.vertex = parse_int(coords[0]);
+         corner.format = CornerFormat::Vertex;
       }
-      else if (coords.size() == 2) // Vertex/Texcoord
+      else if (num_coords == 2) // Vertex/Texcoord
       {
-         size_t coord_vert = translate_index(stoi(coords[0]), vertex.size());
-         size_t coord_tex  = translate_index(stoi(coords[1]), tex.size());
+         corner.vertex = parse_int(coords[0]);
+         corner.texcoord = parse_int(coords[1]);
+         corner.format = CornerFormat::VertexTexCoord;
+      }
+      else if (num_coords == 3 && !coords[1].empty()) // Vertex/Texcoord/Normal
+      {
+         corner.vertex = parse_int(coords[0]);
+         corner.texcoord = parse_int(coords[1]);
+         corner.normal = parse_int(coords[2]);
+         corner.format = CornerFormat::VertexTexCoordNormal;
+      }
+      else if (num_coords == 3 && coords[1].empty()) // Vertex//Normal
+      {
+         corner.vertex = parse_int(coords[0]);
+         corner.normal = parse_int(coords[2]);
+         corner.format = CornerFormat::VertexNormal;
+      }
 
-         if (coord_vert && vertex.size() >= coord_vert)
-            face.vertex = coord_vert - 1;
-         if (coord_tex && tex.size() >= coord_tex)
-            face.texcoord = coord_tex - 1;
+      return corner;
+   }
 
-         mesh.has_vertex = true;
-         mesh.has_texcoord = true;
+   static void parse_chunk(const char *ptr, const char *end, ObjChunk& chunk)
+   {
+      try
+      {
+         Token line, type, data;
+         while (next_line(ptr, end, line))
+         {
+            split_line(line, type, data);
+
+            if (type.is("v"))
+               chunk.vertex.push_back(parse_line<vec3>(data));
+            else if (type.is("vn"))
+               chunk.normal.push_back(parse_line<vec3>(data));
+            else if (type.is("vt"))
+               chunk.tex.push_back(parse_line<vec2>(data));
+            else if (type.is("f"))
+            {
+               ObjFace face;
+               face.first_corner = chunk.corners.size();
+               face.vertex_count = chunk.vertex.size();
+               face.normal_count = chunk.normal.size();
+               face.texcoord_count = chunk.tex.size();
+
+               // Only triangles are supported, extra vertices are ignored.
+               Token vert;
+               for (unsigned i = 0; i < 3 && next_token(data, vert); i++)
+                  chunk.corners.push_back(parse_corner(vert));
+
+               face.num_corners = chunk.corners.size() - face.first_corner;
+               chunk.faces.push_back(face);
+            }
+            else if (type.is("usemtl"))
+               chunk.events.push_back({ObjEvent::UseMtl, chunk.faces.size(), data.str()});
+            else if (type.is("mtllib"))
+               chunk.events.push_back({ObjEvent::MtlLib, chunk.faces.size(), data.str()});
+         }
       }
-      else if (coords.size() == 3 && coords[1].size()) // Vertex/Texcoord/Normal
+      catch (...)
       {
-         size_t coord_vert   = translate_index(stoi(coords[0]), vertex.size());
-         size_t coord_tex    = translate_index(stoi(coords[1]), tex.size());
-         size_t coord_normal = translate_index(stoi(coords[2]), normal.size());
+         chunk.error = current_exception();
+      }
+   }
 
-         if (coord_vert && vertex.size() >= coord_vert)
-            face.vertex = coord_vert - 1;
-         if (coord_tex && tex.size() >= coord_tex)
-            face.texcoord = coord_tex - 1;
-         if (coord_normal && normal.size() >= coord_normal)
-            face.normal = coord_normal - 1;
+   // Runs work(i) for every i below count, the last one on the calling thread.
+   // If a thread can't be started, its work runs here instead. Throwing
+   // would leave the running workers unjoined.
+   template<typename Func>
+   static void run_parallel(size_t count, const Func& work)
+   {
+      vector<thread> workers;
+      workers.reserve(count);
 
-         mesh.has_vertex = true;
-         mesh.has_texcoord = true;
-         mesh.has_normal = true;
-      }
-      else if (coords.size() == 3 && !coords[1].size()) // Vertex//Normal
+      for (size_t i = 0; i < count; i++)
       {
-         size_t coord_vert   = translate_index(stoi(coords[0]), vertex.size());
-         size_t coord_normal = translate_index(stoi(coords[2]), normal.size());
+         bool started = false;
+         if (i + 1 < count)
+         {
+            try
+            {
+               workers.emplace_back(work, i);
+               started = true;
+            }
+            catch (const system_error&)
+            {
+            }
+         }
+         if (!started)
+            work(i);
+      }
 
-         if (coord_vert && vertex.size() >= coord_vert)
-            face.vertex = coord_vert - 1;
-         if (coord_normal && normal.size() >= coord_normal)
-            face.normal = coord_normal - 1;
+      for (auto& worker : workers)
+         worker.join();
+   }
 
-         mesh.has_vertex = true;
-         mesh.has_normal = true;
+   // Splits the file at line boundaries and parses the slices in parallel.
+   static vector<ObjChunk> parse_chunks(const char *ptr, const char *end)
+   {
+      // Small files aren't worth spinning up threads for.
+      static const size_t min_chunk_size = 1024 * 1024;
+
+      size_t size = end - ptr;
+      size_t num_threads = std::max(thread::hardware_concurrency(), 1u);
+      size_t num_chunks = std::min(num_threads, std::max<size_t>(size / min_chunk_size, 1));
+
+      vector<const char*> bounds(num_chunks + 1);
+      bounds[0] = ptr;
+      bounds[num_chunks] = end;
+      for (size_t i = 1; i < num_chunks; i++)
+      {
+         auto chunk_end = std::max(bounds[i - 1], ptr + size * i / num_chunks);
+         auto newline = static_cast<const char*>(memchr(chunk_end, '\n', end - chunk_end));
+         bounds[i] = newline ? newline + 1 : end;
       }
 
-      auto itr = faces.find(face);
-      if (itr == end(faces))
+      vector<ObjChunk> chunks(num_chunks);
+      run_parallel(num_chunks, [&](size_t i) {
+         parse_chunk(bounds[i], bounds[i + 1], chunks[i]);
+      });
+
+      for (auto& chunk : chunks)
+         if (chunk.error)
+            rethrow_exception(chunk.error);
+
+      return chunks;
+   }
+
+   // Resolves a 1-based, possibly relative OBJ index to a 0-based index, or -1 if invalid.
+   static inline int resolve_index(int index, size_t size)
+   {
+      size_t coord = translate_index(index, size);
+      return coord && size >= coord ? int(coord - 1) : -1;
+   }
+
+   // Resolves the corners of a chunk to 0-based attribute indices and deduplicates
+   // them within each segment. Relative indices count back from the attributes seen
+   // before the face, the bases are the attribute counts of the chunks before this one.
+   static void dedupe_chunk(ObjChunk& chunk, size_t vertex_base, size_t normal_base, size_t texcoord_base)
+   {
+      try
       {
-         face.buffer_index = faces.size();
-         faces.insert(face);
+         VertexCache cache;
+         cache.reserve(chunk.faces.size() / 2);
+         chunk.corner_index.resize(chunk.corners.size());
+
+         auto begin_segment = [&] {
+            cache.clear();
+            chunk.segments.push_back({uint32_t(chunk.uniques.size()), 0, 0});
+         };
+         begin_segment();
+
+         auto event = begin(chunk.events);
+         for (size_t i = 0; i < chunk.faces.size(); i++)
+         {
+            for (; event != end(chunk.events) && event->face == i; ++event)
+               if (event->type == ObjEvent::UseMtl)
+                  begin_segment();
 
-         if (face.vertex >= 0)
-            mesh.vbo.insert(end(mesh.vbo),
-                  value_ptr(vertex[face.vertex]),
-                  value_ptr(vertex[face.vertex]) + 3);
+            auto& obj_face = chunk.faces[i];
+            size_t vertex_count = vertex_base + obj_face.vertex_count;
+            size_t normal_count = normal_base + obj_face.normal_count;
+            size_t texcoord_count = texcoord_base + obj_face.texcoord_count;
 
-         if (face.normal >= 0)
-            mesh.vbo.insert(end(mesh.vbo),
-                  value_ptr(normal[face.normal]),
-                  value_ptr(normal[face.normal]) + 3);
+            for (uint32_t c = obj_face.first_corner; c < obj_face.first_corner + obj_face.num_corners; c++)
+            {
+               auto& corner = chunk.corners[c];
+               Face face;
+               switch (corner.format)
+               {
+                  case CornerFormat::VertexTexCoordNormal:
+                     face.normal = resolve_index(corner.normal, normal_count);
+                     // Fallthrough
+                  case CornerFormat::VertexTexCoord:
+                     face.texcoord = resolve_index(corner.texcoord, texcoord_count);
+                     face.vertex = resolve_index(corner.vertex, vertex_count);
+                     break;
+
+                  case CornerFormat::VertexNormal:
+                     face.normal = resolve_index(corner.normal, normal_count);
+                     // Fallthrough
+                  case CornerFormat::Vertex:
+                     face.vertex = resolve_index(corner.vertex, vertex_count);
+                     break;
+
+                  default:
+                     break;
+               }
+
+               auto& segment = chunk.segments.back();
+               segment.formats |= 1u << unsigned(corner.format);
+
+               uint32_t face_hash = VertexCache::hash(face);
+               if (!cache.find_or_insert(face, face_hash))
+               {
+                  chunk.uniques.push_back(face);
+                  chunk.unique_hashes.push_back(face_hash);
+               }
+               chunk.corner_index[c] = face.buffer_index;
+            }
+         }
 
-         if (face.texcoord >= 0)
-            mesh.vbo.insert(end(mesh.vbo),
-                  value_ptr(tex[face.texcoord]),
-                  value_ptr(tex[face.texcoord]) + 2);
+         for (; event != end(chunk.events); ++event)
+            if (event->type == ObjEvent::UseMtl)
+               begin_segment();
 
-         mesh.ibo.push_back(face.buffer_index);
+         for (size_t i = 0; i < chunk.segments.size(); i++)
+         {
+            uint32_t next = i + 1 < chunk.segments.size() ?
+               chunk.segments[i + 1].first_unique : uint32_t(chunk.uniques.size());
+            chunk.segments[i].num_uniques = next - chunk.segments[i].first_unique;
+         }
+      }
+      catch (...)
+      {
+         chunk.error = current_exception();
       }
-      else
-         mesh.ibo.push_back(itr->buffer_index);
    }
 
-   static void parse_face(const string& data,
-         set<Face>& faces,
+   static void set_formats(Mesh& mesh, unsigned formats)
+   {
+      auto has = [formats](CornerFormat format) { return (formats & (1u << unsigned(format))) != 0; };
+
+      if (has(CornerFormat::Vertex) || has(CornerFormat::VertexTexCoord) ||
+            has(CornerFormat::VertexTexCoordNormal) || has(CornerFormat::VertexNormal))
+         mesh.has_vertex = true;
+      if (has(CornerFormat::VertexTexCoord) || has(CornerFormat::VertexTexCoordNormal))
+         mesh.has_texcoord = true;
+      if (has(CornerFormat::VertexTexCoordNormal) || has(CornerFormat::VertexNormal))
+         mesh.has_normal = true;
+   }
+
+   static void append_vertex(const Face& face,
          Mesh& mesh,
          const vector<vec3>& vertex,
          const vector<vec3>& normal,
          const vector<vec2>& tex)
    {
-      vector<string> vertices = String::split(data, " ");
-      if (vertices.size() > 3)
-         vertices.resize(3);
+      if (face.vertex >= 0)
+         mesh.vbo.insert(end(mesh.vbo),
+               value_ptr(vertex[face.vertex]),
+               value_ptr(vertex[face.vertex]) + 3);
+
+      if (face.normal >= 0)
+         mesh.vbo.insert(end(mesh.vbo),
+               value_ptr(normal[face.normal]),
+               value_ptr(normal[face.normal]) + 3);
+
+      if (face.texcoord >= 0)
+         mesh.vbo.insert(end(mesh.vbo),
+               value_ptr(tex[face.texcoord]),
+               value_ptr(tex[face.texcoord]) + 2);
+   }
+
+   template<typename T>
+   static void merge_attributes(vector<T>& out, const vector<ObjChunk>& chunks, vector<T> ObjChunk::*member)
+   {
+      size_t total = 0;
+      for (auto& chunk : chunks)
+         total += (chunk.*member).size();
 
-      for (auto& vert : vertices)
-         parse_vertex(vert, faces, mesh, vertex, normal, tex);
+      out.reserve(total);
+      for (auto& chunk : chunks)
+         out.insert(end(out), begin(chunk.*member), std::end(chunk.*member));
    }
 
    static AABB compute_aabb(const vector<float>& vec, unsigned stride)
@@ -256,41 +970,80 @@ namespace GL
       return aabb;
    }
 
-   vector<Mesh> load_meshes_obj(const string& path)
+   vector<Mesh> load_meshes_obj(const string& path, bool use_cache)
    {
-      vector<Mesh> meshes;
+      auto start_time = chrono::steady_clock::now();
+      auto cache_path = path + ".meshcache";
+
+      if (use_cache && mesh_cache_is_current(cache_path))
+      {
+         try
+         {
+            auto meshes = load_meshes_cache(cache_path);
+            auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time);
+            Log::log("Loaded OBJ %s from cache in %.3f ms.", path.c_str(), elapsed.count());
+            return meshes;
+         }
+         catch (const exception& e)
+         {
+            Log::log("Ignoring mesh cache %s: %s", cache_path.c_str(), e.what());
+         }
+      }
+
+      vector<string> sources = { path };
+
+      File::MappedFile file;
+      if (!file.open(asset_path(path)))
+         throw runtime_error(String::cat("Failed to open OBJ: ", path));
+
+      auto chunks = parse_chunks(file.data(), file.data() + file.size());
 
       vector<vec3> vertex;
       vector<vec3> normal;
       vector<vec2> tex;
+      merge_attributes(vertex, chunks, &ObjChunk::vertex);
+      merge_attributes(normal, chunks, &ObjChunk::normal);
+      merge_attributes(tex, chunks, &ObjChunk::tex);
+
+      // Chunks resolve and deduplicate their corners in parallel, the merge
+      // below only has to look at the distinct corners of each chunk.
+      vector<size_t> vertex_bases, normal_bases, texcoord_bases;
+      size_t vertex_base = 0, normal_base = 0, texcoord_base = 0;
+      for (auto& chunk : chunks)
+      {
+         vertex_bases.push_back(vertex_base);
+         normal_bases.push_back(normal_base);
+         texcoord_bases.push_back(texcoord_base);
+         vertex_base += chunk.vertex.size();
+         normal_base += chunk.normal.size();
+         texcoord_base += chunk.tex.size();
+      }
 
-      Material current_material;
-      map<string, Material> materials;
+      run_parallel(chunks.size(), [&](size_t i) {
+         dedupe_chunk(chunks[i], vertex_bases[i], normal_bases[i], texcoord_bases[i]);
+      });
+      for (auto& chunk : chunks)
+         if (chunk.error)
+            rethrow_exception(chunk.error);
 
+      vector<Mesh> meshes;
+      map<string, Material> materials;
       Mesh current;
 
-      set<Face> faces;
-
-      ifstream file(asset_path(path).c_str(), ios::in);
-      if (!file.is_open())
-         throw runtime_error(String::cat("Failed to open OBJ: ", path));
+      // Only segments spanning chunks go through the table, a single chunk never
+      // touches it. The distinct corners of all chunks bound its size, reserve
+      // that up front to avoid rehashing.
+      VertexCache faces;
+      if (chunks.size() > 1)
+      {
+         size_t total_uniques = 0;
+         for (auto& chunk : chunks)
+            total_uniques += chunk.uniques.size();
+         faces.reserve(total_uniques);
+      }
 
-      for (string line; getline(file, line); )
-      {
-         line = String::strip(line);
-         size_t split_point = line.find_first_of(' ');
-         string type = line.substr(0, split_point);
-         string data = split_point != string::npos ? line.substr(split_point + 1) : string();
-
-         if (type == "v")
-            vertex.push_back(parse_line<vec3>(data));
-         else if (type == "vn")
-            normal.push_back(parse_line<vec3>(data));
-         else if (type == "vt")
-            tex.push_back(parse_line<vec2>(data));
-         else if (type == "f")
-            parse_face(data, faces, current, vertex, normal, tex);
-         else if (type == "usemtl")
+      auto handle_event = [&](const ObjEvent& event) {
+         if (event.type == ObjEvent::UseMtl)
          {
             if (!current.ibo.empty()) // Different texture, new mesh.
             {
@@ -300,10 +1053,67 @@ namespace GL
             }
 
             faces.clear();
-            current.material = materials[data];
+            current.material = materials[event.data];
          }
-         else if (type == "mtllib")
-            materials = parse_mtllib(Path::join(Path::basedir(path), data));
+         else
+         {
+            auto mtl_path = Path::join(Path::basedir(path), event.data);
+            materials = parse_mtllib(mtl_path);
+            sources.push_back(mtl_path);
+         }
+      };
+
+      // Merge chunks in file order.
+      vector<uint32_t> remap;
+      for (size_t k = 0; k < chunks.size(); k++)
+      {
+         auto& chunk = chunks[k];
+         size_t segment = 0;
+
+         // Maps the distinct corners of a segment to vertices of the current mesh.
+         // A segment which starts after usemtl and ends within the chunk can't share
+         // vertices with other chunks, so its corners are new in order.
+         auto begin_segment = [&](bool cleared) {
+            auto& seg = chunk.segments[segment];
+            bool contained = cleared && (segment + 1 < chunk.segments.size() || k + 1 == chunks.size());
+
+            set_formats(current, seg.formats);
+            remap.resize(seg.num_uniques);
+            for (uint32_t u = 0; u < seg.num_uniques; u++)
+            {
+               Face face = chunk.uniques[seg.first_unique + u];
+               if (contained)
+                  face.buffer_index = u;
+               if (contained || !faces.find_or_insert(face, chunk.unique_hashes[seg.first_unique + u]))
+                  append_vertex(face, current, vertex, normal, tex);
+               remap[u] = face.buffer_index;
+            }
+         };
+
+         auto handle_chunk_event = [&](const ObjEvent& event) {
+            handle_event(event);
+            if (event.type == ObjEvent::UseMtl)
+            {
+               segment++;
+               begin_segment(true);
+            }
+         };
+
+         begin_segment(k == 0);
+
+         auto event = begin(chunk.events);
+         for (size_t i = 0; i < chunk.faces.size(); i++)
+         {
+            for (; event != std::end(chunk.events) && event->face == i; ++event)
+               handle_chunk_event(*event);
+
+            auto& obj_face = chunk.faces[i];
+            for (uint32_t c = obj_face.first_corner; c < obj_face.first_corner + obj_face.num_corners; c++)
+               current.ibo.push_back(remap[chunk.corner_index[c]]);
+         }
+
+         for (; event != std::end(chunk.events); ++event)
+            handle_chunk_event(*event);
       }
 
       if (!current.ibo.empty())
@@ -313,15 +1123,23 @@ namespace GL
       }
 
       for (auto& mesh : meshes)
+         mesh.aabb = compute_aabb(mesh.vbo, mesh.vertex_stride());
+
+      auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time);
+      Log::log("Loaded OBJ %s (%zu bytes, %zu chunks) in %.3f ms.",
+            path.c_str(), file.size(), chunks.size(), elapsed.count());
+
+      if (use_cache)
       {
-         unsigned stride = 0;
-         if (mesh.has_vertex)
-            stride += 3;
-         if (mesh.has_normal)
-            stride += 3;
-         if (mesh.has_texcoord)
-            stride += 2;
-         mesh.aabb = compute_aabb(mesh.vbo, stride);
+         try
+         {
+            save_meshes_cache(cache_path, meshes, sources);
+         }
+         catch (const exception& e)
+         {
+            // Read-only install directories are fine, we just parse every time.
+            Log::log("Failed to write mesh cache: %s", e.what());
+         }
       }
 
       return meshes;
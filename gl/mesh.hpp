@@ -3,6 +3,7 @@
 
 #include "global.hpp"
 #include "vertex_array.hpp"
+#include "buffer_pool.hpp"
 #include "aabb.hpp"
 #include <cstdint>
 #include <vector>
@@ -44,6 +45,18 @@ namespace GL
 
    struct Mesh
    {
+      enum Quantization
+      {
+         QuantizeNone = 0,
+         QuantizePositionHalf = 1 << 0,
+         QuantizePositionUnorm16 = 1 << 1, // Relative to aabb, see position_transform().
+         QuantizeNormal = 1 << 2, // GL_INT_2_10_10_10_REV
+         QuantizeTexCoord = 1 << 3, // GL_HALF_FLOAT
+         QuantizeIndices = 1 << 4, // GL_UNSIGNED_SHORT if all indices fit.
+
+         QuantizeAll = QuantizePositionUnorm16 | QuantizeNormal | QuantizeTexCoord | QuantizeIndices
+      };
+
       std::vector<float> vbo;
       std::vector<GLuint> ibo;
       std::vector<VertexArray::Array> arrays;
@@ -54,10 +67,99 @@ namespace GL
 
       Material material;
 
-      void finalize();
+      // Packed vertex and index data written by finalize() when quantizing.
+      // vbo and ibo are kept as is so the mesh can still be processed.
+      std::vector<uint8_t> packed_vbo;
+      std::vector<uint8_t> packed_ibo;
+      GLenum index_type = GL_UNSIGNED_INT;
+      unsigned quantization = QuantizeNone;
+
+      // Lays out arrays and index_type, packing vertices if quantization is requested.
+      // Packed data is a snapshot, finalize again after modifying vbo or ibo.
+      void finalize(unsigned quantization = QuantizeNone);
+
+      // Uploads vertex and index data in the layout chosen by finalize().
+      void init_buffers(Buffer& vertex_buffer, Buffer& index_buffer, GLuint flags = Buffer::None) const;
+
+      // Same, but from a pool. Vertex data is aligned to the vertex size so
+      // meshes of one layout can share a vertex array and draw with baseVertex.
+      void init_buffers(BufferPool& pool, BufferRange& vertex_range, BufferRange& index_range) const;
+
+      // Bytes per index for index_type.
+      GLsizeiptr index_size() const;
+
+      // Maps stored positions to object space. Identity unless positions are unorm16.
+      glm::mat4 position_transform() const;
+
+      // Number of floats per vertex in vbo.
+      unsigned vertex_stride() const;
+   };
+
+   struct VertexCacheStats
+   {
+      float acmr; // Vertex shader invocations per triangle.
+      float atvr; // Vertex shader invocations per unique vertex, 1.0 is optimal.
    };
 
-   std::vector<Mesh> load_meshes_obj(const std::string& path);
+   // Simulates a FIFO post-transform cache of cache_size entries over the index buffer.
+   VertexCacheStats analyze_vertex_cache(const Mesh& mesh, unsigned cache_size = 16);
+
+   // Reorders triangles for post-transform cache reuse (Forsyth) and overdraw (Tipsify-style
+   // clustering), then reorders vbo in first-use order for fetch locality.
+   // Rendered output is unchanged, only the order of triangles and vertices.
+   void optimize_mesh(Mesh& mesh);
+
+   // Renumbers vertices in order of first use and drops unreferenced vertices.
+   void optimize_vertex_fetch(Mesh& mesh);
+
+   // Cluster of triangles, laid out for std430 so an array of these can be used in a shader storage buffer.
+   struct Meshlet
+   {
+      glm::vec4 center_radius; // Bounding sphere in object space.
+
+      // Normal cone. Every triangle in the cluster faces away from a camera at eye if
+      // dot(center - eye, axis) >= cutoff * length(center - eye) + radius.
+      // Cutoff is above 1 when the normals are too spread out for the test to ever pass.
+      glm::vec4 cone_axis_cutoff;
+
+      GLuint first_index; // Triangles are the index range [first_index, first_index + index_count) of ibo.
+      GLuint index_count;
+      GLuint vertex_count; // Unique vertices referenced.
+      GLuint padding;
+   };
+
+   // Groups triangles into clusters of at most max_vertices unique vertices and max_triangles triangles.
+   // Clusters grow through shared vertices, preferring triangles which keep the normal cone tight.
+   // ibo is reordered so every meshlet is a contiguous index range.
+   std::vector<Meshlet> build_meshlets(Mesh& mesh, unsigned max_vertices = 64, unsigned max_triangles = 124);
+
+   // Copies meshlets into a range of pool for use as a shader storage buffer.
+   // Nothing is allocated for an empty vector.
+   BufferRange upload_meshlets(BufferPool& pool, const std::vector<Meshlet>& meshlets);
+
+   // Quadric error metric simplification (Garland & Heckbert) with edge collapses.
+   // Stops at target_triangles or when the next collapse would move the surface more than
+   // max_error, relative to the largest AABB extent. Open borders and attribute seams
+   // (e.g. UV or hard normal discontinuities) only collapse along themselves.
+   // The achieved relative error is written to result_error if not null.
+   Mesh simplify_mesh(const Mesh& mesh, size_t target_triangles, float max_error = 1.0f,
+         float *result_error = nullptr);
+
+   // Returns mesh followed by up to levels - 1 progressively simplified meshes.
+   // Level i is simplified from mesh to ratio^i of its triangles, with max_error
+   // bounding the deviation from mesh itself. The chain ends early once a level
+   // can't be reduced below the previous one.
+   std::vector<Mesh> generate_lod_chain(const Mesh& mesh, unsigned levels,
+         float ratio = 0.5f, float max_error = 1.0f);
+
+   // Parsed OBJ files are cached in binary form next to the source (path + ".meshcache").
+   // The cache is reused as long as the OBJ and its material libraries are unchanged.
+   std::vector<Mesh> load_meshes_obj(const std::string& path, bool use_cache = true);
+
+   std::vector<Mesh> load_meshes_cache(const std::string& path);
+   void save_meshes_cache(const std::string& path, const std::vector<Mesh>& meshes,
+         const std::vector<std::string>& sources);
+   bool mesh_cache_is_current(const std::string& path);
    Mesh create_mesh_box();
 }
 
@@ -0,0 +1,322 @@
+#include "mesh.hpp"
+#include <cstdio>
+
+using namespace std;
+using namespace glm;
+
+namespace GL
+{
+   // Binary mesh cache layout (native endian, every field 4 byte aligned):
+   //
+   // Header: magic "BXMC", version, number of source files, number of meshes.
+   // Sources: size (u64), mtime (i64), asset path (length-prefixed string).
+   // Mesh: attribute flags, AABB, material, vertex array layout (u32 count + 8 u32 fields
+   //       per array), vbo (u64 count + floats), ibo (u64 count + u32 indices).
+   //
+   // Strings are padded to 4 bytes, so arrays can be memcpy'd straight out of the mapping.
+   // Structs with padding are written field by field, so files don't depend on their layout.
+   static const char cache_magic[4] = { 'B', 'X', 'M', 'C' };
+   static const uint32_t cache_version = 2;
+
+   enum CacheMeshFlags
+   {
+      CacheHasVertex = 1 << 0,
+      CacheHasNormal = 1 << 1,
+      CacheHasTexCoord = 1 << 2
+   };
+
+   class CacheWriter
+   {
+      public:
+         template<typename T>
+         void write(const T& t)
+         {
+            write_raw(&t, sizeof(t));
+         }
+
+         void write_string(const string& str)
+         {
+            write(uint32_t(str.size()));
+            write_raw(str.data(), str.size());
+            pad();
+         }
+
+         template<typename T>
+         void write_vector(const vector<T>& vec)
+         {
+            write(uint64_t(vec.size()));
+            write_raw(vec.data(), vec.size() * sizeof(T));
+            pad();
+         }
+
+         void write_raw(const void *data, size_t size)
+         {
+            auto bytes = static_cast<const uint8_t*>(data);
+            buffer.insert(end(buffer), bytes, bytes + size);
+         }
+
+         const vector<uint8_t>& get_buffer() const { return buffer; }
+
+      private:
+         vector<uint8_t> buffer;
+
+         void pad()
+         {
+            buffer.resize((buffer.size() + 3) & ~size_t(3));
+         }
+   };
+
+   class CacheReader
+   {
+      public:
+         CacheReader(const char *data, size_t size)
+            : start(data), ptr(data), end(data + size)
+         {}
+
+         template<typename T>
+         T read()
+         {
+            T t;
+            read_raw(&t, sizeof(t));
+            return t;
+         }
+
+         string read_string()
+         {
+            uint32_t len = read<uint32_t>();
+            string str(len, '\0');
+            read_raw(&str[0], len);
+            pad();
+            return str;
+         }
+
+         template<typename T>
+         void read_vector(vector<T>& vec)
+         {
+            uint64_t count = read<uint64_t>();
+            if (count > uint64_t(end - ptr) / sizeof(T))
+               throw runtime_error("Mesh cache is truncated.");
+
+            vec.resize(count);
+            read_raw(vec.data(), count * sizeof(T));
+            pad();
+         }
+
+         void read_raw(void *data, size_t size)
+         {
+            if (size > size_t(end - ptr))
+               throw runtime_error("Mesh cache is truncated.");
+            memcpy(data, ptr, size);
+            ptr += size;
+         }
+
+         bool at_end() const { return ptr == end; }
+
+      private:
+         const char *start;
+         const char *ptr;
+         const char *end;
+
+         void pad()
+         {
+            while (((ptr - start) & 3) && ptr < end)
+               ptr++;
+         }
+   };
+
+   static void write_arrays(CacheWriter& writer, const vector<VertexArray::Array>& arrays)
+   {
+      writer.write(uint32_t(arrays.size()));
+      for (auto& array : arrays)
+      {
+         writer.write(uint32_t(array.location));
+         writer.write(int32_t(array.size));
+         writer.write(uint32_t(array.type));
+         writer.write(uint32_t(array.normalized));
+         writer.write(uint32_t(array.stride));
+         writer.write(uint32_t(array.buffer_index));
+         writer.write(uint32_t(array.divisor));
+         writer.write(int32_t(array.offset));
+      }
+   }
+
+   static void read_arrays(CacheReader& reader, vector<VertexArray::Array>& arrays)
+   {
+      // Appended as they are read, a corrupt count runs into the end of the file.
+      uint32_t count = reader.read<uint32_t>();
+      arrays.clear();
+      for (uint32_t i = 0; i < count; i++)
+      {
+         VertexArray::Array array;
+         array.location = reader.read<uint32_t>();
+         array.size = reader.read<int32_t>();
+         array.type = reader.read<uint32_t>();
+         array.normalized = reader.read<uint32_t>() ? GL_TRUE : GL_FALSE;
+         array.stride = reader.read<uint32_t>();
+         array.buffer_index = reader.read<uint32_t>();
+         array.divisor = reader.read<uint32_t>();
+         array.offset = reader.read<int32_t>();
+         arrays.push_back(array);
+      }
+   }
+
+   // Reads the header and checks that the file is a mesh cache we understand.
+   static void read_cache_header(CacheReader& reader, uint32_t& num_sources, uint32_t& num_meshes)
+   {
+      char magic[4];
+      reader.read_raw(magic, sizeof(magic));
+      if (memcmp(magic, cache_magic, sizeof(magic)))
+         throw runtime_error("Not a mesh cache.");
+
+      if (reader.read<uint32_t>() != cache_version)
+         throw runtime_error("Mesh cache version mismatch.");
+
+      num_sources = reader.read<uint32_t>();
+      num_meshes = reader.read<uint32_t>();
+   }
+
+   bool mesh_cache_is_current(const string& path)
+   {
+      File::MappedFile file;
+      if (!file.open(asset_path(path)))
+         return false;
+
+      try
+      {
+         CacheReader reader(file.data(), file.size());
+         uint32_t num_sources, num_meshes;
+         read_cache_header(reader, num_sources, num_meshes);
+
+         for (uint32_t i = 0; i < num_sources; i++)
+         {
+            File::Stamp cached;
+            cached.size = reader.read<uint64_t>();
+            cached.mtime = reader.read<int64_t>();
+            auto source = reader.read_string();
+
+            File::Stamp current;
+            if (!File::stamp(asset_path(source), current) || current != cached)
+               return false;
+         }
+
+         return true;
+      }
+      catch (const exception&)
+      {
+         return false;
+      }
+   }
+
+   vector<Mesh> load_meshes_cache(const string& path)
+   {
+      File::MappedFile file;
+      if (!file.open(asset_path(path)))
+         throw runtime_error(String::cat("Failed to open mesh cache: ", path));
+
+      CacheReader reader(file.data(), file.size());
+      uint32_t num_sources, num_meshes;
+      read_cache_header(reader, num_sources, num_meshes);
+
+      for (uint32_t i = 0; i < num_sources; i++)
+      {
+         reader.read<uint64_t>();
+         reader.read<int64_t>();
+         reader.read_string();
+      }
+
+      vector<Mesh> meshes(num_meshes);
+      for (auto& mesh : meshes)
+      {
+         uint32_t flags = reader.read<uint32_t>();
+         mesh.has_vertex = flags & CacheHasVertex;
+         mesh.has_normal = flags & CacheHasNormal;
+         mesh.has_texcoord = flags & CacheHasTexCoord;
+
+         mesh.aabb.base = reader.read<vec3>();
+         mesh.aabb.offset = reader.read<vec3>();
+
+         mesh.material.ambient = reader.read<vec3>();
+         mesh.material.diffuse = reader.read<vec3>();
+         mesh.material.specular = reader.read<vec3>();
+         mesh.material.specular_power = reader.read<float>();
+         mesh.material.diffuse_map = reader.read_string();
+
+         read_arrays(reader, mesh.arrays);
+         reader.read_vector(mesh.vbo);
+         reader.read_vector(mesh.ibo);
+      }
+
+      if (!reader.at_end())
+         throw runtime_error("Trailing data in mesh cache.");
+
+      return meshes;
+   }
+
+   void save_meshes_cache(const string& path, const vector<Mesh>& meshes, const vector<string>& sources)
+   {
+      CacheWriter writer;
+      writer.write_raw(cache_magic, sizeof(cache_magic));
+      writer.write(cache_version);
+      writer.write(uint32_t(sources.size()));
+      writer.write(uint32_t(meshes.size()));
+
+      for (auto& source : sources)
+      {
+         File::Stamp stamp;
+         if (!File::stamp(asset_path(source), stamp))
+            throw runtime_error(String::cat("Failed to stat mesh source: ", source));
+
+         writer.write(stamp.size);
+         writer.write(stamp.mtime);
+         writer.write_string(source);
+      }
+
+      for (auto& mesh : meshes)
+      {
+         uint32_t flags = 0;
+         if (mesh.has_vertex)
+            flags |= CacheHasVertex;
+         if (mesh.has_normal)
+            flags |= CacheHasNormal;
+         if (mesh.has_texcoord)
+            flags |= CacheHasTexCoord;
+         writer.write(flags);
+
+         writer.write(mesh.aabb.base);
+         writer.write(mesh.aabb.offset);
+
+         writer.write(mesh.material.ambient);
+         writer.write(mesh.material.diffuse);
+         writer.write(mesh.material.specular);
+         writer.write(mesh.material.specular_power);
+         writer.write_string(mesh.material.diffuse_map);
+
+         write_arrays(writer, mesh.arrays);
+         writer.write_vector(mesh.vbo);
+         writer.write_vector(mesh.ibo);
+      }
+
+      // Write to a temporary and rename so readers never see a partial cache.
+      auto full_path = asset_path(path);
+      auto tmp_path = full_path + ".tmp";
+      {
+         ofstream file(tmp_path, ios::out | ios::binary | ios::trunc);
+         if (!file.is_open())
+            throw runtime_error(String::cat("Failed to open mesh cache for writing: ", path));
+
+         auto& buffer = writer.get_buffer();
+         file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+         if (!file)
+            throw runtime_error(String::cat("Failed to write mesh cache: ", path));
+      }
+
+#ifdef _WIN32
+      remove(full_path.c_str());
+#endif
+      if (rename(tmp_path.c_str(), full_path.c_str()) != 0)
+      {
+         remove(tmp_path.c_str());
+         throw runtime_error(String::cat("Failed to rename mesh cache: ", path));
+      }
+   }
+}
@@ -0,0 +1,216 @@
+#include "mesh.hpp"
+#include <cmath>
+
+using namespace std;
+using namespace glm;
+
+namespace GL
+{
+   static_assert(sizeof(Meshlet) == 48, "Meshlet must match the std430 layout.");
+
+   static void compute_bounds(const Mesh& mesh, Meshlet& meshlet)
+   {
+      unsigned stride = mesh.vertex_stride();
+      auto position = [&](GLuint index) { return make_vec3(&mesh.vbo[index * stride]); };
+
+      vec3 minimum = position(mesh.ibo[meshlet.first_index]);
+      vec3 maximum = minimum;
+      vec3 normal_sum(0.0f);
+      vector<vec3> normals;
+      normals.reserve(meshlet.index_count / 3);
+
+      for (GLuint i = meshlet.first_index; i < meshlet.first_index + meshlet.index_count; i += 3)
+      {
+         vec3 p0 = position(mesh.ibo[i + 0]);
+         vec3 p1 = position(mesh.ibo[i + 1]);
+         vec3 p2 = position(mesh.ibo[i + 2]);
+         minimum = min(minimum, min(p0, min(p1, p2)));
+         maximum = max(maximum, max(p0, max(p1, p2)));
+
+         vec3 n = cross(p1 - p0, p2 - p0);
+         float n_length = length(n);
+         if (n_length > 0.0f)
+         {
+            normals.push_back(n / n_length);
+            normal_sum += normals.back();
+         }
+      }
+
+      vec3 center = 0.5f * (minimum + maximum);
+      float radius = 0.0f;
+      for (GLuint i = meshlet.first_index; i < meshlet.first_index + meshlet.index_count; i++)
+         radius = std::max(radius, distance(center, position(mesh.ibo[i])));
+      meshlet.center_radius = vec4(center, radius);
+
+      float axis_length = length(normal_sum);
+      if (normals.empty() || axis_length <= 0.0f)
+      {
+         meshlet.cone_axis_cutoff = vec4(0.0f, 0.0f, 0.0f, 2.0f);
+         return;
+      }
+
+      vec3 axis = normal_sum / axis_length;
+      float min_dot = 1.0f;
+      for (auto& n : normals)
+         min_dot = std::min(min_dot, dot(axis, n));
+
+      // All normals are within acos(min_dot) of the axis, so the cluster is backfacing when
+      // the view direction is within 90 - acos(min_dot) degrees of the axis.
+      float cutoff = min_dot > 0.0f ? sqrt(1.0f - min_dot * min_dot) : 2.0f;
+      meshlet.cone_axis_cutoff = vec4(axis, cutoff);
+   }
+
+   // Balances vertex reuse against normal cone size when growing a meshlet.
+   static const float cone_weight = 1.0f;
+
+   vector<Meshlet> build_meshlets(Mesh& mesh, unsigned max_vertices, unsigned max_triangles)
+   {
+      if (max_vertices < 3 || max_triangles < 1)
+         throw logic_error("Meshlets must fit at least one triangle.");
+      if (mesh.ibo.size() % 3)
+         throw logic_error("Mesh is not a triangle list.");
+
+      vector<Meshlet> meshlets;
+      if (!mesh.has_vertex || mesh.ibo.empty())
+         return meshlets;
+
+      unsigned stride = mesh.vertex_stride();
+      size_t num_vertices = mesh.vbo.size() / stride;
+      size_t num_triangles = mesh.ibo.size() / 3;
+      auto& ibo = mesh.ibo;
+
+      // Vertex -> triangle adjacency.
+      vector<unsigned> offsets(num_vertices + 1);
+      for (auto index : ibo)
+         offsets[index + 1]++;
+      for (size_t i = 0; i < num_vertices; i++)
+         offsets[i + 1] += offsets[i];
+      vector<unsigned> adjacency(ibo.size());
+      vector<unsigned> fill(begin(offsets), end(offsets) - 1);
+      for (size_t i = 0; i < ibo.size(); i++)
+         adjacency[fill[ibo[i]]++] = unsigned(i / 3);
+
+      vector<vec3> normals(num_triangles);
+      for (size_t t = 0; t < num_triangles; t++)
+      {
+         vec3 p0 = make_vec3(&mesh.vbo[ibo[3 * t + 0] * stride]);
+         vec3 p1 = make_vec3(&mesh.vbo[ibo[3 * t + 1] * stride]);
+         vec3 p2 = make_vec3(&mesh.vbo[ibo[3 * t + 2] * stride]);
+         vec3 n = cross(p1 - p0, p2 - p0);
+         float n_length = length(n);
+         normals[t] = n_length > 0.0f ? n / n_length : vec3(0.0f);
+      }
+
+      // Stamp of the meshlet a vertex was last added to, avoids clearing a set per meshlet.
+      vector<GLuint> stamps(num_vertices, ~0u);
+      vector<bool> emitted(num_triangles);
+      vector<GLuint> vertices, out;
+      vertices.reserve(max_vertices);
+      out.reserve(ibo.size());
+
+      auto count_new_vertices = [&](size_t t, GLuint stamp) {
+         unsigned count = 0;
+         for (unsigned k = 0; k < 3; k++)
+         {
+            GLuint index = ibo[3 * t + k];
+            bool repeated = (k > 0 && ibo[3 * t] == index) || (k > 1 && ibo[3 * t + 1] == index);
+            if (stamps[index] != stamp && !repeated)
+               count++;
+         }
+         return count;
+      };
+
+      Meshlet current = {};
+      vec3 normal_sum(0.0f);
+      size_t seed = 0;
+
+      for (size_t emitted_count = 0; emitted_count < num_triangles; emitted_count++)
+      {
+         GLuint stamp = GLuint(meshlets.size());
+
+         // Grow the meshlet through triangles sharing its vertices, preferring
+         // few new vertices and normals close to the current cone axis.
+         size_t best = ~size_t(0);
+         float best_score = numeric_limits<float>::max();
+         if (current.index_count / 3 < max_triangles)
+         {
+            float normal_length = length(normal_sum);
+            vec3 axis = normal_length > 0.0f ? normal_sum / normal_length : vec3(0.0f);
+
+            for (auto vertex : vertices)
+            {
+               for (unsigned i = offsets[vertex]; i < offsets[vertex + 1]; i++)
+               {
+                  unsigned t = adjacency[i];
+                  if (emitted[t])
+                     continue;
+
+                  unsigned new_vertices = count_new_vertices(t, stamp);
+                  if (current.vertex_count + new_vertices > max_vertices)
+                     continue;
+
+                  float score = float(new_vertices) + cone_weight * (1.0f - dot(axis, normals[t]));
+                  if (score < best_score)
+                  {
+                     best_score = score;
+                     best = t;
+                  }
+               }
+            }
+         }
+
+         // Nothing adjacent fits, continue from the first triangle left,
+         // in a new meshlet unless it fits in the current one.
+         if (best == ~size_t(0))
+         {
+            while (emitted[seed])
+               seed++;
+            best = seed;
+
+            if (current.vertex_count + count_new_vertices(best, stamp) > max_vertices ||
+                  current.index_count / 3 + 1 > max_triangles)
+            {
+               meshlets.push_back(current);
+               current = {};
+               current.first_index = GLuint(out.size());
+               stamp = GLuint(meshlets.size());
+               vertices.clear();
+               normal_sum = vec3(0.0f);
+            }
+         }
+
+         emitted[best] = true;
+         for (unsigned k = 0; k < 3; k++)
+         {
+            GLuint index = ibo[3 * best + k];
+            out.push_back(index);
+            if (stamps[index] != stamp)
+            {
+               stamps[index] = stamp;
+               vertices.push_back(index);
+               current.vertex_count++;
+            }
+         }
+         current.index_count += 3;
+         normal_sum += normals[best];
+      }
+
+      if (current.index_count)
+         meshlets.push_back(current);
+
+      ibo = move(out);
+      for (auto& meshlet : meshlets)
+         compute_bounds(mesh, meshlet);
+
+      return meshlets;
+   }
+
+   BufferRange upload_meshlets(BufferPool& pool, const vector<Meshlet>& meshlets)
+   {
+      if (meshlets.empty())
+         return BufferRange();
+
+      // 256 is the largest storage buffer offset alignment GL allows, whatever the pool's target.
+      return pool.allocate(meshlets, 256);
+   }
+}
@@ -0,0 +1,363 @@
+#include "mesh.hpp"
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+using namespace glm;
+
+namespace GL
+{
+   static const GLuint invalid_index = ~0u;
+
+   // Cache size the Forsyth scoring function models. Larger than typical FIFO sizes
+   // since LRU scoring degrades gracefully on smaller hardware caches.
+   static const unsigned forsyth_cache_size = 32;
+
+   // Size of the FIFO used to find cluster boundaries for overdraw optimization.
+   static const unsigned overdraw_cache_size = 16;
+
+   // Clusters may only end once their ACMR is within this factor of the whole mesh,
+   // so reordering for overdraw never costs much vertex reuse.
+   static const float overdraw_threshold = 1.05f;
+
+   struct FifoCache
+   {
+      FifoCache(size_t num_vertices, unsigned cache_size)
+         : stamps(num_vertices, 0), time(cache_size + 1), cache_size(cache_size)
+      {}
+
+      // Returns true if the vertex had to be transformed.
+      bool access(GLuint index)
+      {
+         if (time - stamps[index] > cache_size)
+         {
+            stamps[index] = time++;
+            return true;
+         }
+         return false;
+      }
+
+      vector<unsigned> stamps;
+      unsigned time;
+      unsigned cache_size;
+   };
+
+   static size_t count_vertices(const Mesh& mesh)
+   {
+      unsigned stride = mesh.vertex_stride();
+      return stride ? mesh.vbo.size() / stride : 0;
+   }
+
+   VertexCacheStats analyze_vertex_cache(const Mesh& mesh, unsigned cache_size)
+   {
+      VertexCacheStats stats = {};
+      size_t num_vertices = count_vertices(mesh);
+      size_t num_triangles = mesh.ibo.size() / 3;
+      if (!num_triangles || !num_vertices)
+         return stats;
+
+      FifoCache cache(num_vertices, cache_size);
+      vector<bool> referenced(num_vertices);
+      size_t misses = 0, unique = 0;
+
+      for (auto index : mesh.ibo)
+      {
+         if (cache.access(index))
+            misses++;
+         if (!referenced[index])
+         {
+            referenced[index] = true;
+            unique++;
+         }
+      }
+
+      stats.acmr = float(misses) / float(num_triangles);
+      stats.atvr = float(misses) / float(unique);
+      return stats;
+   }
+
+   static float forsyth_vertex_score(int cache_position, unsigned remaining_triangles)
+   {
+      if (!remaining_triangles)
+         return -1.0f;
+
+      float score = 0.0f;
+      if (cache_position >= 0)
+      {
+         // The triangle just emitted gets a fixed score so we don't favour its exact vertices.
+         if (cache_position < 3)
+            score = 0.75f;
+         else
+         {
+            float scale = 1.0f - float(cache_position - 3) / float(forsyth_cache_size - 3);
+            score = pow(scale, 1.5f);
+         }
+      }
+
+      // Boost vertices with few triangles left so we don't leave lone triangles behind.
+      return score + 2.0f / sqrt(float(remaining_triangles));
+   }
+
+   // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation".
+   static vector<GLuint> optimize_vertex_cache(const vector<GLuint>& ibo, size_t num_vertices)
+   {
+      size_t num_triangles = ibo.size() / 3;
+
+      // Vertex -> triangle adjacency. The first remaining[v] entries are triangles not yet emitted.
+      vector<unsigned> offsets(num_vertices + 1);
+      for (auto index : ibo)
+         offsets[index + 1]++;
+      for (size_t i = 0; i < num_vertices; i++)
+         offsets[i + 1] += offsets[i];
+
+      vector<unsigned> remaining(num_vertices);
+      vector<unsigned> adjacency(ibo.size());
+      for (size_t i = 0; i < ibo.size(); i++)
+      {
+         GLuint index = ibo[i];
+         adjacency[offsets[index] + remaining[index]++] = unsigned(i / 3);
+      }
+
+      vector<int> cache_position(num_vertices, -1);
+      vector<float> vertex_score(num_vertices);
+      for (size_t i = 0; i < num_vertices; i++)
+         vertex_score[i] = forsyth_vertex_score(-1, remaining[i]);
+
+      auto triangle_score = [&](size_t t) {
+         return vertex_score[ibo[3 * t + 0]] + vertex_score[ibo[3 * t + 1]] + vertex_score[ibo[3 * t + 2]];
+      };
+
+      vector<bool> emitted(num_triangles);
+      size_t best_triangle = 0;
+      for (size_t i = 1; i < num_triangles; i++)
+         if (triangle_score(i) > triangle_score(best_triangle))
+            best_triangle = i;
+
+      vector<GLuint> cache, new_cache;
+      cache.reserve(forsyth_cache_size + 3);
+      new_cache.reserve(forsyth_cache_size + 3);
+
+      vector<GLuint> out;
+      out.reserve(ibo.size());
+      size_t scan_cursor = 0;
+
+      for (size_t emitted_count = 0; emitted_count < num_triangles; emitted_count++)
+      {
+         // Nothing useful in the cache, restart from the first triangle left.
+         if (best_triangle == invalid_index)
+         {
+            while (emitted[scan_cursor])
+               scan_cursor++;
+            best_triangle = scan_cursor;
+         }
+
+         emitted[best_triangle] = true;
+         const GLuint *tri = &ibo[3 * best_triangle];
+
+         new_cache.clear();
+         for (unsigned k = 0; k < 3; k++)
+         {
+            GLuint index = tri[k];
+            out.push_back(index);
+            new_cache.push_back(index);
+
+            // Remove the triangle from the live part of the adjacency list.
+            auto first = begin(adjacency) + offsets[index];
+            auto last = first + remaining[index];
+            iter_swap(find(first, last, unsigned(best_triangle)), last - 1);
+            remaining[index]--;
+         }
+
+         for (auto index : cache)
+            if (index != tri[0] && index != tri[1] && index != tri[2])
+               new_cache.push_back(index);
+
+         // Rescore everything that was in the cache, including vertices that just fell out.
+         for (size_t i = 0; i < new_cache.size(); i++)
+         {
+            GLuint index = new_cache[i];
+            cache_position[index] = i < forsyth_cache_size ? int(i) : -1;
+            vertex_score[index] = forsyth_vertex_score(cache_position[index], remaining[index]);
+         }
+
+         best_triangle = invalid_index;
+         float best_score = -1.0f;
+         for (auto index : new_cache)
+         {
+            for (unsigned i = 0; i < remaining[index]; i++)
+            {
+               unsigned t = adjacency[offsets[index] + i];
+               float score = triangle_score(t);
+               if (score > best_score)
+               {
+                  best_score = score;
+                  best_triangle = t;
+               }
+            }
+         }
+
+         if (new_cache.size() > forsyth_cache_size)
+            new_cache.resize(forsyth_cache_size);
+         swap(cache, new_cache);
+      }
+
+      return out;
+   }
+
+   struct TriangleCluster
+   {
+      size_t first_triangle;
+      size_t num_triangles;
+      float sort_key;
+   };
+
+   // Splits the cache optimized index buffer into clusters at points where the
+   // cache is cold anyway, then sorts the clusters so that outward facing
+   // clusters draw first (Sander et al., "Fast Triangle Reordering for Vertex
+   // Locality and Reduced Overdraw").
+   static vector<GLuint> optimize_overdraw(const vector<GLuint>& ibo, const Mesh& mesh, size_t num_vertices)
+   {
+      size_t num_triangles = ibo.size() / 3;
+      unsigned stride = mesh.vertex_stride();
+
+      FifoCache total_cache(num_vertices, overdraw_cache_size);
+      size_t total_misses = 0;
+      for (auto index : ibo)
+         if (total_cache.access(index))
+            total_misses++;
+      float total_acmr = float(total_misses) / float(num_triangles);
+
+      vector<TriangleCluster> clusters;
+      FifoCache cache(num_vertices, overdraw_cache_size);
+      size_t cluster_misses = 0;
+      TriangleCluster cluster = {};
+
+      for (size_t i = 0; i < num_triangles; i++)
+      {
+         unsigned misses = 0;
+         for (unsigned k = 0; k < 3; k++)
+            if (cache.access(ibo[3 * i + k]))
+               misses++;
+
+         bool hard_boundary = misses == 3;
+         if (hard_boundary && cluster.num_triangles &&
+               float(cluster_misses) / float(cluster.num_triangles) <= total_acmr * overdraw_threshold)
+         {
+            clusters.push_back(cluster);
+            cluster.first_triangle = i;
+            cluster.num_triangles = 0;
+            cluster_misses = 0;
+         }
+
+         cluster.num_triangles++;
+         cluster_misses += misses;
+      }
+      clusters.push_back(cluster);
+
+      if (clusters.size() < 2)
+         return ibo;
+
+      // Area weighted centroid and normal per cluster.
+      vector<vec3> centroids(clusters.size());
+      vector<vec3> normals(clusters.size());
+      vector<float> areas(clusters.size());
+      vec3 mesh_centroid(0.0f);
+      float mesh_area = 0.0f;
+
+      for (size_t c = 0; c < clusters.size(); c++)
+      {
+         vec3 centroid(0.0f), normal(0.0f);
+         float area = 0.0f;
+         for (size_t i = clusters[c].first_triangle;
+               i < clusters[c].first_triangle + clusters[c].num_triangles; i++)
+         {
+            vec3 p0 = make_vec3(&mesh.vbo[ibo[3 * i + 0] * stride]);
+            vec3 p1 = make_vec3(&mesh.vbo[ibo[3 * i + 1] * stride]);
+            vec3 p2 = make_vec3(&mesh.vbo[ibo[3 * i + 2] * stride]);
+            vec3 n = cross(p1 - p0, p2 - p0);
+            float tri_area = 0.5f * length(n);
+
+            centroid += (p0 + p1 + p2) * (tri_area / 3.0f);
+            normal += n;
+            area += tri_area;
+         }
+
+         centroids[c] = area > 0.0f ? centroid / area : centroid;
+         float normal_length = length(normal);
+         normals[c] = normal_length > 0.0f ? normal / normal_length : normal;
+         areas[c] = area;
+
+         mesh_centroid += centroid;
+         mesh_area += area;
+      }
+
+      if (mesh_area > 0.0f)
+         mesh_centroid /= mesh_area;
+
+      for (size_t c = 0; c < clusters.size(); c++)
+         clusters[c].sort_key = dot(centroids[c] - mesh_centroid, normals[c]);
+
+      stable_sort(begin(clusters), end(clusters), [](const TriangleCluster& a, const TriangleCluster& b) {
+         return a.sort_key > b.sort_key;
+      });
+
+      vector<GLuint> out;
+      out.reserve(ibo.size());
+      for (auto& cluster : clusters)
+      {
+         auto first = begin(ibo) + 3 * cluster.first_triangle;
+         out.insert(end(out), first, first + 3 * cluster.num_triangles);
+      }
+      return out;
+   }
+
+   void optimize_vertex_fetch(Mesh& mesh)
+   {
+      size_t num_vertices = count_vertices(mesh);
+      unsigned stride = mesh.vertex_stride();
+      vector<GLuint> remap(num_vertices, invalid_index);
+      vector<float> vbo;
+      vbo.reserve(mesh.vbo.size());
+
+      GLuint next_index = 0;
+      for (auto& index : mesh.ibo)
+      {
+         if (remap[index] == invalid_index)
+         {
+            remap[index] = next_index++;
+            auto first = begin(mesh.vbo) + index * stride;
+            vbo.insert(end(vbo), first, first + stride);
+         }
+         index = remap[index];
+      }
+
+      mesh.vbo = move(vbo);
+   }
+
+   void optimize_mesh(Mesh& mesh)
+   {
+      size_t num_vertices = count_vertices(mesh);
+      if (mesh.ibo.empty() || !num_vertices)
+         return;
+
+      if (mesh.ibo.size() % 3)
+         throw logic_error("Mesh is not a triangle list.");
+      for (auto index : mesh.ibo)
+         if (index >= num_vertices)
+            throw logic_error("Mesh index out of range.");
+
+      auto start_time = chrono::steady_clock::now();
+      auto before = analyze_vertex_cache(mesh);
+
+      mesh.ibo = optimize_vertex_cache(mesh.ibo, num_vertices);
+      if (mesh.has_vertex)
+         mesh.ibo = optimize_overdraw(mesh.ibo, mesh, num_vertices);
+      optimize_vertex_fetch(mesh);
+
+      auto after = analyze_vertex_cache(mesh);
+      auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time);
+      Log::log("Optimized mesh (%zu vertices, %zu triangles) in %.3f ms: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f.",
+            count_vertices(mesh), mesh.ibo.size() / 3, elapsed.count(),
+            before.acmr, after.acmr, before.atvr, after.atvr);
+   }
+}
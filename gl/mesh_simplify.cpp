@@ -0,0 +1,647 @@
+#include "mesh.hpp"
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+using namespace glm;
+
+namespace GL
+{
+   // Boundary constraint planes are weighted this much more than surface planes
+   // so borders and seams keep their shape.
+   static const double boundary_weight = 10.0;
+
+   // Symmetric 4x4 error quadric. w accumulates plane weights so the error
+   // can be normalized back to a distance.
+   struct Quadric
+   {
+      double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+      double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+      double a22 = 0.0, a23 = 0.0;
+      double a33 = 0.0;
+      double w = 0.0;
+
+      Quadric() = default;
+
+      Quadric(const dvec3& n, double d, double weight)
+      {
+         a00 = weight * n.x * n.x;
+         a01 = weight * n.x * n.y;
+         a02 = weight * n.x * n.z;
+         a03 = weight * n.x * d;
+         a11 = weight * n.y * n.y;
+         a12 = weight * n.y * n.z;
+         a13 = weight * n.y * d;
+         a22 = weight * n.z * n.z;
+         a23 = weight * n.z * d;
+         a33 = weight * d * d;
+         w = weight;
+      }
+
+      Quadric& operator+=(const Quadric& q)
+      {
+         a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+         a11 += q.a11; a12 += q.a12; a13 += q.a13;
+         a22 += q.a22; a23 += q.a23;
+         a33 += q.a33;
+         w += q.w;
+         return *this;
+      }
+
+      // Weighted mean squared distance from p to the accumulated planes.
+      double error(const vec3& p) const
+      {
+         double x = p.x, y = p.y, z = p.z;
+         double e = a00 * x * x + a11 * y * y + a22 * z * z + a33 +
+            2.0 * (a01 * x * y + a02 * x * z + a12 * y * z + a03 * x + a13 * y + a23 * z);
+         return w > 0.0 ? std::max(e / w, 0.0) : 0.0;
+      }
+   };
+
+   enum class VertexKind
+   {
+      Manifold, // Interior vertex, one set of attributes.
+      Border, // On an open edge, may only slide along the border.
+      Seam, // On an attribute seam, may only slide along the seam.
+      Locked // Seam/border junctions and non-manifold vertices.
+   };
+
+   struct HalfEdge
+   {
+      GLuint from, to; // Position ids.
+      GLuint from_index, to_index; // Vertex indices.
+
+      GLuint min_pos() const { return std::min(from, to); }
+      GLuint max_pos() const { return std::max(from, to); }
+   };
+
+   struct Collapse
+   {
+      GLuint from, to; // Position ids, from is removed.
+      double error;
+   };
+
+   // Compressed sparse rows mapping a position id to a list of items.
+   struct Adjacency
+   {
+      vector<unsigned> offsets;
+      vector<unsigned> items;
+
+      template<typename Func>
+      void build(size_t num_keys, size_t num_items, const Func& key)
+      {
+         offsets.assign(num_keys + 1, 0);
+         for (size_t i = 0; i < num_items; i++)
+            offsets[key(i) + 1]++;
+         for (size_t i = 0; i < num_keys; i++)
+            offsets[i + 1] += offsets[i];
+
+         items.resize(num_items);
+         vector<unsigned> fill(begin(offsets), end(offsets) - 1);
+         for (size_t i = 0; i < num_items; i++)
+            items[fill[key(i)]++] = unsigned(i);
+      }
+
+      const unsigned *begin_of(GLuint key) const { return items.data() + offsets[key]; }
+      const unsigned *end_of(GLuint key) const { return items.data() + offsets[key + 1]; }
+   };
+
+   class Simplifier
+   {
+      public:
+         Simplifier(const Mesh& mesh)
+            : mesh(mesh), stride(mesh.vertex_stride()), indices(mesh.ibo)
+         {
+            size_t num_vertices = mesh.vbo.size() / stride;
+            weld_positions(num_vertices);
+
+            remap.resize(num_vertices);
+            for (size_t i = 0; i < num_vertices; i++)
+               remap[i] = GLuint(i);
+
+            vec3 extent = mesh.aabb.offset;
+            scale = std::max(std::max(extent.x, extent.y), extent.z);
+            if (scale <= 0.0f)
+               scale = 1.0f;
+
+            remove_degenerate_triangles();
+            build_topology();
+            compute_quadrics();
+         }
+
+         float simplify(size_t target_triangles, float max_error)
+         {
+            double max_error_sq = double(max_error) * max_error * scale * scale;
+
+            while (indices.size() / 3 > target_triangles)
+            {
+               if (!collapse_pass(target_triangles, max_error_sq))
+                  break;
+               build_topology();
+            }
+
+            return float(sqrt(result_error_sq)) / scale;
+         }
+
+         const vector<GLuint>& get_indices() const { return indices; }
+
+      private:
+         const Mesh& mesh;
+         unsigned stride;
+         float scale;
+         double result_error_sq = 0.0;
+
+         vector<GLuint> indices;
+         vector<GLuint> remap; // Vertex index -> vertex index it collapsed into.
+         vector<GLuint> position_id; // Vertex index -> welded position.
+         vector<vec3> positions;
+         vector<Quadric> quadrics;
+
+         // Rebuilt after every pass.
+         vector<HalfEdge> edges; // Sorted so both halves of an edge are adjacent.
+         vector<VertexKind> kinds;
+         Adjacency triangles; // Position -> triangles.
+         Adjacency copies; // Position -> vertex indices in use.
+
+         GLuint pos(size_t corner) const { return position_id[indices[corner]]; }
+
+         // Vertices split on attribute seams share position, so all topology is in position space.
+         void weld_positions(size_t num_vertices)
+         {
+            vector<GLuint> order(num_vertices);
+            for (size_t i = 0; i < num_vertices; i++)
+               order[i] = GLuint(i);
+
+            auto vertex = [this](GLuint index) { return make_vec3(&mesh.vbo[index * stride]); };
+            auto less_pos = [&](GLuint a, GLuint b) {
+               vec3 pa = vertex(a), pb = vertex(b);
+               if (pa.x != pb.x)
+                  return pa.x < pb.x;
+               if (pa.y != pb.y)
+                  return pa.y < pb.y;
+               return pa.z < pb.z;
+            };
+            sort(begin(order), end(order), less_pos);
+
+            position_id.resize(num_vertices);
+            for (size_t i = 0; i < num_vertices; i++)
+            {
+               if (i == 0 || less_pos(order[i - 1], order[i]))
+                  positions.push_back(vertex(order[i]));
+               position_id[order[i]] = GLuint(positions.size() - 1);
+            }
+         }
+
+         void build_topology()
+         {
+            size_t num_triangles = indices.size() / 3;
+            size_t num_positions = positions.size();
+
+            triangles.build(num_positions, indices.size(), [this](size_t i) { return pos(i); });
+            // Triangle lists store corners, convert to triangle indices.
+            for (auto& item : triangles.items)
+               item /= 3;
+
+            // Distinct vertex indices per position.
+            vector<GLuint> used(indices);
+            sort(begin(used), end(used));
+            used.erase(unique(begin(used), end(used)), end(used));
+            copies.build(num_positions, used.size(), [&](size_t i) { return position_id[used[i]]; });
+            for (auto& item : copies.items)
+               item = used[item];
+
+            edges.clear();
+            edges.reserve(indices.size());
+            for (size_t t = 0; t < num_triangles; t++)
+            {
+               for (unsigned k = 0; k < 3; k++)
+               {
+                  size_t a = 3 * t + k;
+                  size_t b = 3 * t + (k + 1) % 3;
+                  edges.push_back({ pos(a), pos(b), indices[a], indices[b] });
+               }
+            }
+
+            sort(begin(edges), end(edges), [](const HalfEdge& a, const HalfEdge& b) {
+               if (a.min_pos() != b.min_pos())
+                  return a.min_pos() < b.min_pos();
+               return a.max_pos() < b.max_pos();
+            });
+
+            vector<unsigned> border_edges(num_positions), seam_edges(num_positions);
+            kinds.assign(num_positions, VertexKind::Manifold);
+
+            for_each_edge([&](const HalfEdge *first, size_t count) {
+               GLuint a = first->min_pos(), b = first->max_pos();
+               if (count == 1)
+               {
+                  border_edges[a]++;
+                  border_edges[b]++;
+               }
+               else if (count == 2)
+               {
+                  if (is_seam(first[0], first[1]))
+                  {
+                     seam_edges[a]++;
+                     seam_edges[b]++;
+                  }
+               }
+               else
+               {
+                  kinds[a] = VertexKind::Locked;
+                  kinds[b] = VertexKind::Locked;
+               }
+            });
+
+            for (size_t i = 0; i < num_positions; i++)
+            {
+               if (kinds[i] == VertexKind::Locked)
+                  continue;
+
+               size_t num_copies = copies.end_of(GLuint(i)) - copies.begin_of(GLuint(i));
+               if (border_edges[i] && seam_edges[i])
+                  kinds[i] = VertexKind::Locked;
+               else if (border_edges[i])
+                  kinds[i] = border_edges[i] == 2 && num_copies == 1 ? VertexKind::Border : VertexKind::Locked;
+               else if (seam_edges[i])
+                  kinds[i] = seam_edges[i] == 2 && num_copies == 2 ? VertexKind::Seam : VertexKind::Locked;
+               else if (num_copies > 1)
+                  kinds[i] = VertexKind::Locked;
+            }
+         }
+
+         template<typename Func>
+         void for_each_edge(const Func& func) const
+         {
+            for (size_t i = 0; i < edges.size(); )
+            {
+               size_t count = 1;
+               while (i + count < edges.size() &&
+                     edges[i + count].min_pos() == edges[i].min_pos() &&
+                     edges[i + count].max_pos() == edges[i].max_pos())
+                  count++;
+
+               func(&edges[i], count);
+               i += count;
+            }
+         }
+
+         // Two triangles sharing an edge disagree on attributes at one of its ends.
+         static bool is_seam(const HalfEdge& a, const HalfEdge& b)
+         {
+            GLuint a_from = a.from_index, a_to = a.to_index;
+            if (a.from != b.from)
+               swap(a_from, a_to);
+            return a_from != b.from_index || a_to != b.to_index;
+         }
+
+         void compute_quadrics()
+         {
+            quadrics.assign(positions.size(), Quadric());
+
+            for (size_t t = 0; t < indices.size() / 3; t++)
+            {
+               dvec3 p0 = dvec3(positions[pos(3 * t + 0)]);
+               dvec3 p1 = dvec3(positions[pos(3 * t + 1)]);
+               dvec3 p2 = dvec3(positions[pos(3 * t + 2)]);
+
+               dvec3 n = cross(p1 - p0, p2 - p0);
+               double area = length(n);
+               if (area <= 0.0)
+                  continue;
+               n /= area;
+
+               Quadric q(n, -dot(n, p0), 0.5 * area);
+               for (unsigned k = 0; k < 3; k++)
+                  quadrics[pos(3 * t + k)] += q;
+            }
+
+            // Planes perpendicular to the surface through border and seam edges.
+            for_each_edge([&](const HalfEdge *first, size_t count) {
+               if (count == 2 && !is_seam(first[0], first[1]))
+                  return;
+               if (count > 2)
+                  return;
+
+               for (size_t i = 0; i < count; i++)
+               {
+                  auto& edge = first[i];
+
+                  dvec3 a = dvec3(positions[edge.from]);
+                  dvec3 b = dvec3(positions[edge.to]);
+                  dvec3 normal = triangle_normal(edge);
+                  dvec3 dir = b - a;
+                  double edge_length = length(dir);
+                  if (edge_length <= 0.0)
+                     continue;
+
+                  dvec3 n = cross(dir / edge_length, normal);
+                  double n_length = length(n);
+                  if (n_length <= 0.0)
+                     continue;
+                  n /= n_length;
+
+                  Quadric q(n, -dot(n, a), boundary_weight * edge_length * edge_length);
+                  quadrics[edge.from] += q;
+                  quadrics[edge.to] += q;
+               }
+            });
+         }
+
+         // Normal of a triangle containing the half edge, found through the adjacency.
+         dvec3 triangle_normal(const HalfEdge& edge) const
+         {
+            for (auto t = triangles.begin_of(edge.from); t != triangles.end_of(edge.from); t++)
+            {
+               const GLuint *tri = &indices[3 * *t];
+               for (unsigned k = 0; k < 3; k++)
+               {
+                  if (tri[k] == edge.from_index && tri[(k + 1) % 3] == edge.to_index)
+                  {
+                     dvec3 p0 = dvec3(positions[position_id[tri[0]]]);
+                     dvec3 p1 = dvec3(positions[position_id[tri[1]]]);
+                     dvec3 p2 = dvec3(positions[position_id[tri[2]]]);
+                     dvec3 n = cross(p1 - p0, p2 - p0);
+                     double n_length = length(n);
+                     return n_length > 0.0 ? n / n_length : n;
+                  }
+               }
+            }
+            return dvec3(0.0);
+         }
+
+         bool can_collapse_kind(GLuint from, size_t edge_count, bool seam) const
+         {
+            switch (kinds[from])
+            {
+               case VertexKind::Manifold:
+                  return true;
+               case VertexKind::Border:
+                  return edge_count == 1;
+               case VertexKind::Seam:
+                  return edge_count == 2 && seam;
+               default:
+                  return false;
+            }
+         }
+
+         // Finds the vertex index every copy of from maps to. Each copy must meet
+         // exactly one copy of to in the triangles it is used by.
+         bool map_copies(GLuint from, GLuint to, vector<pair<GLuint, GLuint>>& mapping) const
+         {
+            mapping.clear();
+            for (auto c = copies.begin_of(from); c != copies.end_of(from); c++)
+            {
+               GLuint target = ~0u;
+               for (auto t = triangles.begin_of(from); t != triangles.end_of(from); t++)
+               {
+                  const GLuint *tri = &indices[3 * *t];
+                  if (tri[0] != *c && tri[1] != *c && tri[2] != *c)
+                     continue;
+
+                  for (unsigned k = 0; k < 3; k++)
+                  {
+                     if (position_id[tri[k]] != to)
+                        continue;
+                     if (target != ~0u && target != tri[k])
+                        return false;
+                     target = tri[k];
+                  }
+               }
+
+               if (target == ~0u)
+                  return false;
+               mapping.push_back({ GLuint(*c), target });
+            }
+            return true;
+         }
+
+         // Moving from onto to must not flip or degenerate any triangle that survives.
+         bool preserves_orientation(GLuint from, GLuint to) const
+         {
+            for (auto t = triangles.begin_of(from); t != triangles.end_of(from); t++)
+            {
+               const GLuint *tri = &indices[3 * *t];
+               vec3 p[3];
+               vec3 moved[3];
+               bool has_to = false;
+               for (unsigned k = 0; k < 3; k++)
+               {
+                  GLuint id = position_id[tri[k]];
+                  has_to = has_to || id == to;
+                  p[k] = positions[id];
+                  moved[k] = id == from ? positions[to] : p[k];
+               }
+
+               if (has_to)
+                  continue;
+
+               vec3 n0 = cross(p[1] - p[0], p[2] - p[0]);
+               vec3 n1 = cross(moved[1] - moved[0], moved[2] - moved[0]);
+               if (dot(n0, n1) <= 0.25f * length(n0) * length(n1))
+                  return false;
+            }
+            return true;
+         }
+
+         void neighbors(GLuint vertex, vector<GLuint>& out) const
+         {
+            out.clear();
+            for (auto t = triangles.begin_of(vertex); t != triangles.end_of(vertex); t++)
+               for (unsigned k = 0; k < 3; k++)
+               {
+                  GLuint id = pos(3 * *t + k);
+                  if (id != vertex)
+                     out.push_back(id);
+               }
+            sort(begin(out), end(out));
+            out.erase(unique(begin(out), end(out)), end(out));
+         }
+
+         // Link condition: the only shared neighbors are the ones opposite the edge,
+         // otherwise the collapse pinches the surface.
+         bool preserves_topology(GLuint from, GLuint to, size_t edge_count,
+               vector<GLuint>& from_neighbors, vector<GLuint>& to_neighbors) const
+         {
+            neighbors(from, from_neighbors);
+            neighbors(to, to_neighbors);
+
+            size_t shared = 0;
+            auto a = begin(from_neighbors);
+            auto b = begin(to_neighbors);
+            while (a != end(from_neighbors) && b != end(to_neighbors))
+            {
+               if (*a < *b)
+                  ++a;
+               else if (*b < *a)
+                  ++b;
+               else
+               {
+                  shared++;
+                  ++a;
+                  ++b;
+               }
+            }
+            return shared <= edge_count;
+         }
+
+         bool collapse_pass(size_t target_triangles, double max_error_sq)
+         {
+            vector<Collapse> collapses;
+            collapses.reserve(edges.size() / 2);
+
+            for_each_edge([&](const HalfEdge *first, size_t count) {
+               if (count > 2)
+                  return;
+
+               bool seam = count == 2 && is_seam(first[0], first[1]);
+               GLuint a = first->min_pos(), b = first->max_pos();
+
+               Collapse best = { 0, 0, numeric_limits<double>::max() };
+               if (can_collapse_kind(a, count, seam))
+                  best = { a, b, collapse_error(a, b) };
+               if (can_collapse_kind(b, count, seam))
+               {
+                  double error = collapse_error(b, a);
+                  if (error < best.error)
+                     best = { b, a, error };
+               }
+
+               if (best.from != best.to && best.error <= max_error_sq)
+                  collapses.push_back(best);
+            });
+
+            sort(begin(collapses), end(collapses), [](const Collapse& a, const Collapse& b) {
+               return a.error < b.error;
+            });
+
+            size_t num_triangles = indices.size() / 3;
+            vector<bool> locked(positions.size());
+            vector<pair<GLuint, GLuint>> mapping;
+            vector<GLuint> from_neighbors, to_neighbors;
+            bool progress = false;
+
+            for (auto& collapse : collapses)
+            {
+               if (num_triangles <= target_triangles)
+                  break;
+               if (locked[collapse.from] || locked[collapse.to])
+                  continue;
+
+               size_t edge_triangles = 0;
+               for (auto t = triangles.begin_of(collapse.from); t != triangles.end_of(collapse.from); t++)
+                  for (unsigned k = 0; k < 3; k++)
+                     if (pos(3 * *t + k) == collapse.to)
+                        edge_triangles++;
+
+               if (!map_copies(collapse.from, collapse.to, mapping))
+                  continue;
+               if (!preserves_orientation(collapse.from, collapse.to))
+                  continue;
+               if (!preserves_topology(collapse.from, collapse.to, edge_triangles, from_neighbors, to_neighbors))
+                  continue;
+
+               for (auto& map : mapping)
+                  remap[map.first] = map.second;
+               quadrics[collapse.to] += quadrics[collapse.from];
+               result_error_sq = std::max(result_error_sq, collapse.error);
+
+               // Everything touching the removed vertex changed, leave it for the next pass.
+               locked[collapse.from] = true;
+               locked[collapse.to] = true;
+               for (auto neighbor : from_neighbors)
+                  locked[neighbor] = true;
+
+               num_triangles -= edge_triangles;
+               progress = true;
+            }
+
+            if (!progress)
+               return false;
+
+            for (auto& index : indices)
+               index = remap[index];
+            remove_degenerate_triangles();
+            return true;
+         }
+
+         // Drops triangles which lost an edge to a collapse (or had none to begin with).
+         void remove_degenerate_triangles()
+         {
+            size_t out = 0;
+            for (size_t t = 0; t < indices.size() / 3; t++)
+            {
+               GLuint p0 = pos(3 * t + 0), p1 = pos(3 * t + 1), p2 = pos(3 * t + 2);
+               if (p0 == p1 || p1 == p2 || p2 == p0)
+                  continue;
+
+               indices[out++] = indices[3 * t + 0];
+               indices[out++] = indices[3 * t + 1];
+               indices[out++] = indices[3 * t + 2];
+            }
+            indices.resize(out);
+         }
+
+         double collapse_error(GLuint from, GLuint to) const
+         {
+            Quadric q = quadrics[from];
+            q += quadrics[to];
+            return q.error(positions[to]);
+         }
+   };
+
+   Mesh simplify_mesh(const Mesh& mesh, size_t target_triangles, float max_error, float *result_error)
+   {
+      if (result_error)
+         *result_error = 0.0f;
+
+      if (!mesh.has_vertex || mesh.ibo.size() / 3 <= target_triangles)
+         return mesh;
+      if (mesh.ibo.size() % 3)
+         throw logic_error("Mesh is not a triangle list.");
+
+      Simplifier simplifier(mesh);
+      float error = simplifier.simplify(target_triangles, max_error);
+      if (result_error)
+         *result_error = error;
+
+      Mesh lod = mesh;
+      lod.ibo = simplifier.get_indices();
+      optimize_vertex_fetch(lod);
+      lod.finalize(mesh.quantization);
+      return lod;
+   }
+
+   vector<Mesh> generate_lod_chain(const Mesh& mesh, unsigned levels, float ratio, float max_error)
+   {
+      auto start_time = chrono::steady_clock::now();
+
+      vector<Mesh> lods;
+      lods.push_back(mesh);
+
+      // Every level is simplified from the source, so max_error and the logged
+      // error are relative to the source mesh rather than accumulating per level.
+      size_t source_triangles = mesh.ibo.size() / 3;
+      double scale = 1.0;
+      for (unsigned i = 1; i < levels; i++)
+      {
+         size_t triangles = lods.back().ibo.size() / 3;
+         scale *= ratio;
+         size_t target = size_t(source_triangles * scale);
+
+         float error = 0.0f;
+         auto lod = simplify_mesh(mesh, target, max_error, &error);
+         size_t lod_triangles = lod.ibo.size() / 3;
+         if (lod_triangles >= triangles)
+            break;
+
+         Log::log("LOD %u: %zu -> %zu triangles (target %zu), relative error %.4f.",
+               i, source_triangles, lod_triangles, target, error);
+         lods.push_back(move(lod));
+      }
+
+      auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time);
+      Log::log("Generated %zu LOD levels in %.3f ms.", lods.size(), elapsed.count());
+      return lods;
+   }
+}
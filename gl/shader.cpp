@@ -1,6 +1,9 @@
 #include "shader.hpp"
 #include "util.hpp"
+#include "thread_pool.hpp"
+#include "state.hpp"
 #include <vector>
+#include <chrono>
 
 using namespace std;
 using namespace Log;
@@ -49,117 +52,281 @@ namespace GL
       log("Program error:\n%s", buf.data());
    }
 
-   void Shader::compile_shader(GLuint obj, const string& source,
-         const vector<string>& defines)
+   // Permutation defines go between version and preamble, as #extension
+   // directives have to come before anything that isn't preprocessor.
+   static const GLchar shader_version[] = "#version 430\n";
+   static const GLchar *shader_preamble[] = {
+      "layout(std140) uniform;\n",
+      "layout(std430) buffer;\n",
+      "#define GLOBAL_VERTEX_DATA 0\n",
+      "#define GLOBAL_FRAGMENT_DATA 1\n",
+      "#define MODEL_TRANSFORM 2\n",
+      "#define MATERIAL 3\n",
+      "#define VERTEX 0\n",
+      "#define TEXCOORD 1\n",
+      "#define NORMAL 2\n",
+      "#define MODEL_INSTANCED 3\n",
+   };
+
+   static vector<const GLchar*> full_source(const string& source, const vector<string>& defines)
    {
-      vector<const GLchar*> gl_source = {
-         "#version 430\nlayout(std140) uniform;\n",
-         "layout(std430) buffer;\n",
-         "#define GLOBAL_VERTEX_DATA 0\n",
-         "#define GLOBAL_FRAGMENT_DATA 1\n",
-         "#define MODEL_TRANSFORM 2\n",
-         "#define MATERIAL 3\n",
-         "#define VERTEX 0\n",
-         "#define TEXCOORD 1\n",
-         "#define NORMAL 2\n",
-         "#define MODEL_INSTANCED 3\n",
-      };
+      vector<const GLchar*> gl_source = { shader_version };
       for (auto& define : defines)
          gl_source.push_back(define.c_str());
+      gl_source.insert(end(gl_source), begin(shader_preamble), end(shader_preamble));
       gl_source.push_back(source.c_str());
+      return gl_source;
+   }
 
+   // Doesn't query the status, so drivers with parallel compile can return right away.
+   GLuint Shader::compile_shader(GLenum type, const string& source,
+         const vector<string>& defines)
+   {
+      GLuint obj = glCreateShader(type);
+      auto gl_source = full_source(source, defines);
       glShaderSource(obj, gl_source.size(), gl_source.data(), nullptr);
       glCompileShader(obj);
+      return obj;
+   }
 
+   void Shader::check_shader(GLuint obj, const string& source,
+         const vector<string>& defines)
+   {
       GLint status = 0;
       glGetShaderiv(obj, GL_COMPILE_STATUS, &status);
       if (!status)
-         log_shader(obj, gl_source);
+         log_shader(obj, full_source(source, defines));
    }
 
-   vector<string> Shader::current_defines() const
+   vector<string> Shader::permutation_defines(unsigned permute) const
    {
       vector<string> ret;
+      for (auto& extension : extensions)
+         if (extension.second(context_caps()))
+            ret.push_back(String::cat("#extension ", extension.first, " : enable\n"));
+      if (dynamic_bits)
+         ret.push_back(String::cat("layout(location = ", unsigned(DynamicDefinesLocation), ") uniform uint dynamic_defines;\n"));
+
+      // Dynamic defines expand to a uniform read, shaders must test them with
+      // if () rather than #if. With a constant value the branch folds away.
       for (auto& define : defines)
-         ret.push_back(String::cat("#define ",
-                  define.name, " ", to_string(define.value), "\n"));
+      {
+         if (define.dynamic)
+            ret.push_back(String::cat("#define ", define.name,
+                     " int(bitfieldExtract(dynamic_defines, ", define.start_bit, ", ", define.bits, "))\n"));
+         else
+            ret.push_back(String::cat("#define ",
+                     define.name, " ", to_string((permute >> define.start_bit) & ((1 << define.bits) - 1)), "\n"));
+      }
       for (auto& define : global_defines)
          ret.push_back(String::cat("#define ",
-                  define.name, " ", to_string(define.value), "\n"));
+                  define.name, " ", to_string((permute >> (total_bits + define.start_bit)) & ((1 << define.bits) - 1)), "\n"));
       return ret;
    }
 
-   GLuint Shader::compile_shaders()
+   // FNV-1a over everything that goes into a program, plus the driver which produced the binary.
+   uint64_t Shader::program_key(const vector<string>& defines) const
    {
-      GLuint prog = glCreateProgram();
+      uint64_t hash = 0xcbf29ce484222325ull;
+      auto feed = [&hash](const string& str) {
+         for (char c : str)
+         {
+            hash ^= uint8_t(c);
+            hash *= 0x100000001b3ull;
+         }
+         // Separator, so moving text between strings changes the key.
+         hash ^= 0xff;
+         hash *= 0x100000001b3ull;
+      };
+
+      feed(context_caps().driver);
+      feed(shader_version);
+      for (auto str : shader_preamble)
+         feed(str);
+      for (auto& define : defines)
+         feed(define);
+      feed(source_vs);
+      feed(source_fs);
+      feed(source_gs);
+      feed(source_compute);
+      return hash;
+   }
+
+   string Shader::cache_path(unsigned permute) const
+   {
+      return String::cat(cache_base, ".", permute, ".progbin");
+   }
+
+   Shader::Program Shader::begin_program(unsigned permute)
+   {
+      resolve_sources();
+      Program program;
+      program.start_time = chrono::steady_clock::now();
+      auto defines = permutation_defines(permute);
+
+      // One cache file per permutation, a changed key just overwrites it.
+      bool use_cache = context_caps().program_binary && !cache_base.empty();
+      if (use_cache)
+      {
+         program.key = program_key(defines);
+         program.prog = load_program_binary(cache_path(permute), program.key);
+         if (program.prog)
+         {
+            auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - program.start_time);
+            log("Shader cache hit: %s in %.3f ms.", cache_path(permute).c_str(), elapsed.count());
+            return program;
+         }
+      }
+
+      program.prog = glCreateProgram();
+      if (use_cache)
+         glProgramParameteri(program.prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
-      auto defines = current_defines();
 #ifdef GL_DEBUG
          log("Compiling shader with defines:");
          for (auto& define : defines)
             log("\t%s", define.c_str());
 #endif
 
-      GLuint vert = 0, geom = 0, frag = 0, comp = 0;
-
       if (source_compute.empty())
       {
-         vert = glCreateShader(GL_VERTEX_SHADER);
-         geom = !source_gs.empty() ? glCreateShader(GL_GEOMETRY_SHADER) : 0;
-         frag = glCreateShader(GL_FRAGMENT_SHADER);
+         program.stages[0] = compile_shader(GL_VERTEX_SHADER, source_vs, defines);
+         program.stages[1] = compile_shader(GL_FRAGMENT_SHADER, source_fs, defines);
+         if (!source_gs.empty())
+            program.stages[2] = compile_shader(GL_GEOMETRY_SHADER, source_gs, defines);
+      }
+      else
+         program.stages[3] = compile_shader(GL_COMPUTE_SHADER, source_compute, defines);
+
+      for (auto stage : program.stages)
+         if (stage)
+            glAttachShader(program.prog, stage);
 
-         compile_shader(vert, source_vs, defines);
-         compile_shader(frag, source_fs, defines);
+      glLinkProgram(program.prog);
+      program.pending = true;
+      return program;
+   }
+
+   bool Shader::program_ready(const Program& program) const
+   {
+      if (!program.pending || !context_caps().parallel_shader_compile)
+         return true;
+
+      GLint done = GL_FALSE;
+      glGetProgramiv(program.prog, GL_COMPLETION_STATUS_KHR, &done);
+      return done == GL_TRUE;
+   }
 
-         glAttachShader(prog, vert);
-         glAttachShader(prog, frag);
+   void Shader::finish_program(unsigned permute, Program& program)
+   {
+      if (!program.pending)
+         return;
 
-         if (geom)
+      auto defines = permutation_defines(permute);
+      const string *sources[] = { &source_vs, &source_fs, &source_gs, &source_compute };
+      for (unsigned i = 0; i < 4; i++)
+      {
+         if (program.stages[i])
          {
-            compile_shader(geom, source_gs, defines);
-            glAttachShader(prog, geom);
+            check_shader(program.stages[i], *sources[i], defines);
+            glDeleteShader(program.stages[i]);
+            program.stages[i] = 0;
          }
       }
-      else
+
+      log_program(program.prog);
+      program.pending = false;
+
+      if (context_caps().program_binary && !cache_base.empty())
       {
-         comp = glCreateShader(GL_COMPUTE_SHADER);
-         compile_shader(comp, source_compute, defines);
-         glAttachShader(prog, comp);
+         save_program_binary(cache_path(permute), program.key, program.prog);
+         auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - program.start_time);
+         log("Shader cache miss: %s, linked %.3f ms after start.", cache_path(permute).c_str(), elapsed.count());
       }
+   }
 
-      glLinkProgram(prog);
-      log_program(prog);
+   Shader::DefineHandle Shader::reserve_define(const string& name, unsigned define_bits, DefineMode mode)
+   {
+      if (!progs.empty())
+         throw logic_error("Defines must be reserved before any program is built.");
 
-      if (vert)
-         glDeleteShader(vert);
-      if (frag)
-         glDeleteShader(frag);
-      if (geom)
-         glDeleteShader(geom);
-      if (comp)
-         glDeleteShader(comp);
+      if (mode == Dynamic)
+      {
+         defines.push_back({dynamic_bits, define_bits, 0, name, true});
+         dynamic_bits += define_bits;
+         if (dynamic_bits > 32)
+            throw std::runtime_error("32 bits of dynamic define space exceeded.");
+      }
+      else
+      {
+         defines.push_back({total_bits, define_bits, 0, name, false});
+         total_bits += define_bits;
+         if (total_bits > 16)
+            throw std::runtime_error("16 bits of define space exceeded.");
+      }
+      return handle_for(defines.size() - 1);
+   }
+
+   void Shader::enable_extension(const string& name, const string& gl_extension)
+   {
+      if (!progs.empty())
+         throw logic_error("Extensions must be enabled before any program is built.");
+      auto ext = gl_extension.empty() ? name : gl_extension;
+      enable_extension(name, [ext](const Capabilities&) {
+         return Capabilities::has_extension(ext.c_str());
+      });
+   }
 
-      return prog;
+   void Shader::enable_extension(const string& name, ExtensionTest supported)
+   {
+      if (!progs.empty())
+         throw logic_error("Extensions must be enabled before any program is built.");
+      extensions.push_back({name, move(supported)});
    }
 
-   void Shader::reserve_define(const string& name, unsigned define_bits)
+   Shader::DefineHandle Shader::handle_for(unsigned index) const
    {
-      defines.push_back({total_bits, define_bits, 0, name});
-      total_bits += define_bits;
-      if (total_bits > 16)
-         throw std::runtime_error("16 bits of define space exceeded.");
+      auto& define = defines[index];
+      return { index, define.start_bit, (1u << define.bits) - 1, define.dynamic };
    }
 
+   // Local defines take the low bits, global defines follow right after,
+   // so permutations stay dense enough to index progs directly.
    unsigned Shader::compute_permutation() const
    {
       unsigned permute = 0;
       for (auto& define : defines)
-         permute |= define.value << define.start_bit;
+         if (!define.dynamic)
+            permute |= define.value << define.start_bit;
       for (auto& define : global_defines)
-         permute |= define.value << (define.start_bit + 16);
+         permute |= define.value << (total_bits + define.start_bit);
       return permute;
    }
 
+   Shader::DefineHandle Shader::find_define(const string& name) const
+   {
+      auto itr = find_if(begin(defines),
+            end(defines), [&name](const Define& def) {
+            return def.name == name;
+            });
+
+      if (itr == end(defines))
+         throw logic_error(String::cat("Undeclared define: ", name));
+      return handle_for(itr - begin(defines));
+   }
+
+   void Shader::set_define(DefineHandle handle, unsigned value)
+   {
+      value &= handle.mask;
+      defines[handle.index].value = value;
+      if (handle.dynamic)
+         dynamic_value = (dynamic_value & ~(handle.mask << handle.start_bit)) | (value << handle.start_bit);
+      else
+         current_permutation = (current_permutation & ~(handle.mask << handle.start_bit)) | (value << handle.start_bit);
+      if (active)
+         use();
+   }
+
    void Shader::set_define(const string& name, unsigned value)
    {
       auto itr = find_if(begin(defines),
@@ -168,20 +335,27 @@ namespace GL
             });
 
       if (itr != end(defines))
-      {
-         itr->value = value & ((1 << itr->bits) - 1);
-         current_permutation = compute_permutation();
-         if (active)
-            use();
-      }
+         set_define(handle_for(itr - begin(defines)), value);
    }
 
-   void Shader::reserve_global_define(const string& name, unsigned define_bits)
+   Shader::GlobalDefineHandle Shader::reserve_global_define(const string& name, unsigned define_bits)
    {
-      global_defines.push_back({total_global_bits, define_bits, 0, name});
+      GlobalDefineHandle handle = { unsigned(global_defines.size()), total_global_bits, (1u << define_bits) - 1 };
+      global_defines.push_back({total_global_bits, define_bits, 0, name, false});
       total_global_bits += define_bits;
       if (total_global_bits > 16)
          throw std::runtime_error("16 bits of global define space exceeded.");
+      return handle;
+   }
+
+   void Shader::set_global_define(GlobalDefineHandle handle, unsigned value)
+   {
+      value &= handle.mask;
+      global_defines[handle.index].value = value;
+      unsigned shift = total_bits + handle.start_bit;
+      current_permutation = (current_permutation & ~(handle.mask << shift)) | (value << shift);
+      if (active)
+         use();
    }
 
    void Shader::set_global_define(const string& name, unsigned value)
@@ -192,66 +366,191 @@ namespace GL
             });
 
       if (itr != end(global_defines))
-      {
-         itr->value = value & ((1 << itr->bits) - 1);
-         current_permutation = compute_permutation();
-         if (active)
-            use();
-      }
+         set_global_define(GlobalDefineHandle{ unsigned(itr - begin(global_defines)), itr->start_bit, (1u << itr->bits) - 1 }, value);
+   }
+
+   static future<string> read_source_async(const string& path)
+   {
+      auto apath = asset_path(path);
+      return Util::ThreadPool::get().submit([apath] { return File::read_string(apath); });
+   }
+
+   void Shader::resolve_sources()
+   {
+      if (pending_vs.valid())
+         source_vs = pending_vs.get();
+      if (pending_fs.valid())
+         source_fs = pending_fs.get();
+      if (pending_gs.valid())
+         source_gs = pending_gs.get();
+      if (pending_compute.valid())
+         source_compute = pending_compute.get();
    }
 
    void Shader::init(const string& path_vs, const string& path_fs, const string& path_gs)
    {
+      source_vs.clear();
+      source_fs.clear();
+      source_gs.clear();
       source_compute.clear();
-      source_vs = File::read_string(asset_path(path_vs));
-      source_fs = File::read_string(asset_path(path_fs));
-      source_gs = !path_gs.empty() ? File::read_string(asset_path(path_fs)) : "";
+      pending_compute = {};
 
-      if (alive)
-         for (auto& prog : progs)
-            glDeleteProgram(prog.second);
+      pending_vs = read_source_async(path_vs);
+      pending_fs = read_source_async(path_fs);
+      pending_gs = !path_gs.empty() ? read_source_async(path_gs) : future<string>();
+      cache_base = asset_path(path_vs);
+      precompiled.clear();
 
+      if (alive)
+         delete_programs();
       progs.clear();
    }
 
    void Shader::init_compute(const string& path_compute)
    {
-      source_compute = File::read_string(asset_path(path_compute));
+      source_vs.clear();
+      source_fs.clear();
+      source_gs.clear();
+      pending_vs = {};
+      pending_fs = {};
+      pending_gs = {};
 
-      if (alive)
-         for (auto& prog : progs)
-            glDeleteProgram(prog.second);
+      source_compute.clear();
+      pending_compute = read_source_async(path_compute);
+      cache_base = asset_path(path_compute);
+      precompiled.clear();
 
+      if (alive)
+         delete_programs();
       progs.clear();
    }
 
-   void Shader::use()
+   void Shader::precompile(const vector<Permutation>& subset)
+   {
+      unsigned global_bits = compute_permutation() & ~((1u << total_bits) - 1);
+
+      if (subset.empty())
+      {
+         for (unsigned permute = 0; permute < (1u << total_bits); permute++)
+            precompiled.push_back(permute | global_bits);
+      }
+      else
+      {
+         for (auto& permutation : subset)
+         {
+            unsigned permute = current_permutation;
+            for (auto& value : permutation)
+            {
+               auto handle = find_define(value.first);
+               if (handle.dynamic)
+                  continue;
+               permute &= ~(handle.mask << handle.start_bit);
+               permute |= (value.second & handle.mask) << handle.start_bit;
+            }
+            precompiled.push_back(permute);
+         }
+      }
+
+      if (alive)
+         begin_precompiled();
+   }
+
+   void Shader::begin_precompiled()
+   {
+      if (context_caps().parallel_shader_compile && glMaxShaderCompilerThreadsKHR)
+         glMaxShaderCompilerThreadsKHR(0xffffffffu);
+
+      for (auto permute : precompiled)
+      {
+         auto& program = lookup_program(permute);
+         if (!program.prog)
+            program = begin_program(permute);
+      }
+   }
+
+   Shader::Program& Shader::lookup_program(unsigned permute)
+   {
+      // Sized for the full define space on first use, global defines may be reserved late.
+      if (permute >= progs.size())
+         progs.resize(1u << (total_bits + total_global_bits));
+      return progs[permute];
+   }
+
+   bool Shader::ready()
    {
-      GLuint prog = progs[current_permutation];
-      if (!prog)
-         progs[current_permutation] = prog = compile_shaders();
+      if (!alive)
+         return false;
 
-      glUseProgram(prog);
+      if (precompiled.empty())
+      {
+         precompiled.push_back(current_permutation);
+         begin_precompiled();
+      }
+
+      bool done = true;
+      for (auto permute : precompiled)
+      {
+         auto& program = lookup_program(permute);
+         if (program_ready(program))
+            finish_program(permute, program);
+         else
+            done = false;
+      }
+      return done;
+   }
+
+   void Shader::use()
+   {
+      auto& program = lookup_program(current_permutation);
+      if (!program.prog)
+         program = begin_program(current_permutation);
+
+      // Blocks if the compile is still running.
+      if (program.pending)
+         finish_program(current_permutation, program);
+      State::get().use_program(program.prog);
       active = true;
+
+      // Uniforms live in the program, so each one keeps track of what it was last given.
+      if (dynamic_bits && program.dynamic_value != dynamic_value)
+      {
+         glUniform1ui(DynamicDefinesLocation, dynamic_value);
+         program.dynamic_value = dynamic_value;
+      }
    }
 
    void Shader::unbind()
    {
-      glUseProgram(0);
+      State::get().use_program(0);
       active = false;
    }
 
    void Shader::reset()
    {
       alive = true;
+      begin_precompiled();
    }
 
    void Shader::destroyed()
    {
       alive = false;
-      for (auto& prog : progs)
-         glDeleteProgram(prog.second);
+      delete_programs();
       progs.clear();
    }
+
+   void Shader::delete_programs()
+   {
+      for (auto& program : progs)
+      {
+         if (!program.prog)
+            continue;
+
+         for (auto stage : program.stages)
+            if (stage)
+               glDeleteShader(stage);
+         glDeleteProgram(program.prog);
+         State::get().deleted_program(program.prog);
+      }
+   }
 }
 
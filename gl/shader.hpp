@@ -3,7 +3,10 @@
 
 #include "global.hpp"
 #include <vector>
-#include <map>
+#include <future>
+#include <chrono>
+#include <utility>
+#include <functional>
 
 namespace GL
 {
@@ -51,17 +54,75 @@ namespace GL
          void use();
          void unbind();
 
+         // Define values by name, defines left out keep their current value.
+         typedef std::vector<std::pair<std::string, unsigned>> Permutation;
+
+         // Starts compiling permutations ahead of their first use(), all of
+         // them when subset is empty. Can be called before the context exists,
+         // compiles then start on context reset.
+         void precompile(const std::vector<Permutation>& subset = {});
+
+         // Polls whether every precompiled permutation, or the current one if none
+         // were requested, is linked so use() won't wait on the compiler.
+         bool ready();
+
          void reset() override;
          void destroyed() override;
 
-         void reserve_define(const std::string& name, unsigned bits);
+         // Handles select a define with a few integer ops, prefer them over names in per-frame code.
+         struct DefineHandle
+         {
+            unsigned index;
+            unsigned start_bit;
+            unsigned mask;
+            bool dynamic;
+         };
+
+         struct GlobalDefineHandle
+         {
+            unsigned index;
+            unsigned start_bit;
+            unsigned mask;
+         };
+
+         // Permuted defines build one program per value. Dynamic defines are
+         // read from a uniform by a single program, so changing them doesn't
+         // switch programs, at the cost of branching in the shader.
+         enum DefineMode
+         {
+            Permuted,
+            Dynamic
+         };
+
+         // Reserve all defines before the first program is built.
+         DefineHandle reserve_define(const std::string& name, unsigned bits, DefineMode mode = Permuted);
+         void set_define(DefineHandle handle, unsigned value);
          void set_define(const std::string& name, unsigned value);
 
-         static void reserve_global_define(const std::string& name, unsigned bits);
+         // Enables a GLSL extension if the context reports gl_extension (the
+         // same name by default), shaders test for its macro. Like defines,
+         // call this before the first program is built.
+         void enable_extension(const std::string& name, const std::string& gl_extension = "");
+         // For extensions that need more than the GL name, e.g. capability bits.
+         typedef std::function<bool (const Capabilities&)> ExtensionTest;
+         void enable_extension(const std::string& name, ExtensionTest supported);
+
+         static GlobalDefineHandle reserve_global_define(const std::string& name, unsigned bits);
+         void set_global_define(GlobalDefineHandle handle, unsigned value);
          void set_global_define(const std::string& name, unsigned value);
 
       private:
-         std::map<unsigned, GLuint> progs;
+         struct Program
+         {
+            GLuint prog = 0;
+            GLuint stages[4] = {}; // Vertex, fragment, geometry, compute. Kept until the link finishes.
+            bool pending = false;
+            uint64_t key = 0;
+            std::chrono::steady_clock::time_point start_time;
+            unsigned dynamic_value = ~0u; // Last value of the dynamic_defines uniform.
+         };
+         std::vector<Program> progs; // Indexed by permutation.
+         std::vector<unsigned> precompiled;
          unsigned current_permutation = 0;
 
          unsigned total_bits = 0;
@@ -71,23 +132,50 @@ namespace GL
             unsigned bits;
             unsigned value;
             std::string name;
+            bool dynamic;
          };
          std::vector<Define> defines;
+         std::vector<std::pair<std::string, ExtensionTest>> extensions; // GLSL name, test.
+
+         enum { DynamicDefinesLocation = 0 };
+         unsigned dynamic_bits = 0;
+         unsigned dynamic_value = 0;
 
          static unsigned total_global_bits;
          static std::vector<Define> global_defines;
 
          std::string source_vs, source_fs, source_gs, source_compute;
+         std::string cache_base; // Program binaries are cached next to this source.
+         // Sources are read on the thread pool and resolved before the first compile.
+         std::future<std::string> pending_vs, pending_fs, pending_gs, pending_compute;
          bool alive = false;
 
-         unsigned compile_shaders();
-         void compile_shader(GLuint obj, const std::string& source,
+         void resolve_sources();
+         void delete_programs();
+
+         Program& lookup_program(unsigned permute);
+         Program begin_program(unsigned permute);
+         bool program_ready(const Program& program) const;
+         void finish_program(unsigned permute, Program& program);
+         void begin_precompiled();
+
+         uint64_t program_key(const std::vector<std::string>& defines) const;
+         std::string cache_path(unsigned permute) const;
+
+         // Program binary cache, see shader_cache.cpp.
+         static GLuint load_program_binary(const std::string& path, uint64_t key);
+         static void save_program_binary(const std::string& path, uint64_t key, GLuint prog);
+         static GLuint compile_shader(GLenum type, const std::string& source,
+               const std::vector<std::string>& defines);
+         void check_shader(GLuint obj, const std::string& source,
                const std::vector<std::string>& defines);
          void log_shader(GLuint obj, const std::vector<const GLchar*>& source);
          void log_program(GLuint obj);
 
-         std::vector<std::string> current_defines() const;
+         std::vector<std::string> permutation_defines(unsigned permute) const;
          unsigned compute_permutation() const;
+         DefineHandle find_define(const std::string& name) const;
+         DefineHandle handle_for(unsigned index) const;
 
          bool active = false;
    };
@@ -0,0 +1,138 @@
+#include "shader.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+using namespace Log;
+
+namespace GL
+{
+   // Program binary cache layout (native endian):
+   //
+   // Header: magic "BXPB", version, program key (u64), binary format, binary size.
+   // Followed by the binary as returned by glGetProgramBinary.
+   //
+   // The key covers sources, defines and driver strings. Anything that doesn't
+   // match, or that the driver refuses to load, is treated as a miss and
+   // overwritten after the next compile.
+   static const char cache_magic[4] = { 'B', 'X', 'P', 'B' };
+   static const uint32_t cache_version = 1;
+
+   struct ProgramBinaryHeader
+   {
+      char magic[4];
+      uint32_t version;
+      uint64_t key;
+      uint32_t format;
+      uint32_t size;
+   };
+
+   GLuint Shader::load_program_binary(const string& path, uint64_t key)
+   {
+      File::MappedFile file;
+      if (!file.open(path))
+         return 0;
+
+      ProgramBinaryHeader header;
+      if (file.size() < sizeof(header))
+      {
+         log("Ignoring shader cache %s: truncated.", path.c_str());
+         return 0;
+      }
+
+      memcpy(&header, file.data(), sizeof(header));
+      if (memcmp(header.magic, cache_magic, sizeof(cache_magic)) || header.version != cache_version)
+      {
+         log("Ignoring shader cache %s: not a program binary.", path.c_str());
+         return 0;
+      }
+
+      if (header.key != key)
+      {
+         log("Ignoring shader cache %s: stale.", path.c_str());
+         return 0;
+      }
+
+      if (header.size != file.size() - sizeof(header))
+      {
+         log("Ignoring shader cache %s: truncated.", path.c_str());
+         return 0;
+      }
+
+      GLuint prog = glCreateProgram();
+      glProgramBinary(prog, header.format, file.data() + sizeof(header), header.size);
+
+      // Drivers may reject binaries at any time, e.g. after an update that kept the version string.
+      GLint status = 0;
+      glGetProgramiv(prog, GL_LINK_STATUS, &status);
+      if (!status)
+      {
+         log("Ignoring shader cache %s: rejected by driver.", path.c_str());
+         glDeleteProgram(prog);
+         return 0;
+      }
+
+      return prog;
+   }
+
+   void Shader::save_program_binary(const string& path, uint64_t key, GLuint prog)
+   {
+      GLint status = 0;
+      glGetProgramiv(prog, GL_LINK_STATUS, &status);
+      if (!status)
+         return;
+
+      GLint length = 0;
+      glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+      if (length <= 0)
+         return;
+
+      vector<char> binary(sizeof(ProgramBinaryHeader) + length);
+      ProgramBinaryHeader header;
+      memcpy(header.magic, cache_magic, sizeof(cache_magic));
+      header.version = cache_version;
+      header.key = key;
+
+      GLenum format = 0;
+      GLsizei written = 0;
+      glGetProgramBinary(prog, length, &written, &format, binary.data() + sizeof(header));
+      if (!written)
+         return;
+
+      header.format = format;
+      header.size = written;
+      memcpy(binary.data(), &header, sizeof(header));
+      binary.resize(sizeof(header) + written);
+
+      // Write to a temporary and rename so readers never see a partial binary.
+      // A cache that can't be written is not an error, we just compile again next time.
+      auto tmp_path = path + ".tmp";
+      {
+         ofstream file(tmp_path, ios::out | ios::binary | ios::trunc);
+         if (!file.is_open())
+         {
+            log("Failed to open shader cache for writing: %s", path.c_str());
+            return;
+         }
+
+         file.write(binary.data(), binary.size());
+         if (!file)
+         {
+            log("Failed to write shader cache: %s", path.c_str());
+            file.close();
+            remove(tmp_path.c_str());
+            return;
+         }
+      }
+
+#ifdef _WIN32
+      remove(path.c_str());
+#endif
+      if (rename(tmp_path.c_str(), path.c_str()) != 0)
+      {
+         remove(tmp_path.c_str());
+         log("Failed to rename shader cache: %s", path.c_str());
+      }
+   }
+}
@@ -0,0 +1,249 @@
+#include "state.hpp"
+
+using namespace std;
+
+namespace GL
+{
+   // Log counts for the first frame that isn't cold, then every 10 seconds at 60 fps.
+   static const unsigned stats_log_interval = 600;
+
+   // Table slots of the tracked targets, -1 if a target isn't tracked.
+   static int buffer_slot(GLenum target)
+   {
+      switch (target)
+      {
+         case GL_ARRAY_BUFFER: return 0;
+         case GL_ATOMIC_COUNTER_BUFFER: return 1;
+         case GL_COPY_READ_BUFFER: return 2;
+         case GL_COPY_WRITE_BUFFER: return 3;
+         case GL_DISPATCH_INDIRECT_BUFFER: return 4;
+         case GL_DRAW_INDIRECT_BUFFER: return 5;
+         case GL_PIXEL_PACK_BUFFER: return 6;
+         case GL_PIXEL_UNPACK_BUFFER: return 7;
+         case GL_SHADER_STORAGE_BUFFER: return 8;
+         case GL_TEXTURE_BUFFER: return 9;
+         case GL_TRANSFORM_FEEDBACK_BUFFER: return 10;
+         case GL_UNIFORM_BUFFER: return 11;
+         default: return -1;
+      }
+   }
+
+   static int indexed_slot(GLenum target)
+   {
+      switch (target)
+      {
+         case GL_ATOMIC_COUNTER_BUFFER: return 0;
+         case GL_SHADER_STORAGE_BUFFER: return 1;
+         case GL_TRANSFORM_FEEDBACK_BUFFER: return 2;
+         case GL_UNIFORM_BUFFER: return 3;
+         default: return -1;
+      }
+   }
+
+   static int texture_slot(GLenum target)
+   {
+      switch (target)
+      {
+         case GL_TEXTURE_1D: return 0;
+         case GL_TEXTURE_1D_ARRAY: return 1;
+         case GL_TEXTURE_2D: return 2;
+         case GL_TEXTURE_2D_ARRAY: return 3;
+         case GL_TEXTURE_CUBE_MAP: return 4;
+         default: return -1;
+      }
+   }
+
+   State& State::get()
+   {
+      static State state;
+      return state;
+   }
+
+   void State::begin_frame()
+   {
+      last_stats = stats;
+      stats = Stats();
+      invalidate();
+
+      frame++;
+      if (frame == 2 || frame % stats_log_interval == 0)
+      {
+#ifdef GL_STATE_CACHE
+         Log::log("GL state: %u calls issued, %u elided last frame.", last_stats.issued, last_stats.elided);
+#else
+         Log::log("GL state: %u calls issued last frame (cache disabled).", last_stats.issued);
+#endif
+      }
+   }
+
+   void State::invalidate()
+   {
+      valid_program = false;
+      valid_vertex_array = false;
+      valid_active_unit = false;
+      valid_buffers.reset();
+      valid_ranges.reset();
+      valid_textures.reset();
+      valid_samplers.reset();
+   }
+
+   bool State::filter()
+   {
+#ifdef GL_STATE_CACHE
+      stats.elided++;
+      return true;
+#else
+      return false;
+#endif
+   }
+
+   void State::use_program(GLuint prog)
+   {
+      if (valid_program && program == prog && filter())
+         return;
+
+      stats.issued++;
+      glUseProgram(prog);
+      program = prog;
+      valid_program = true;
+   }
+
+   void State::bind_vertex_array(GLuint vao)
+   {
+      if (valid_vertex_array && vertex_array == vao && filter())
+         return;
+
+      stats.issued++;
+      glBindVertexArray(vao);
+      vertex_array = vao;
+      valid_vertex_array = true;
+   }
+
+   void State::bind_buffer(GLenum target, GLuint buffer)
+   {
+      // The element array binding belongs to the vertex array, it has no slot.
+      int slot = buffer_slot(target);
+      if (slot >= 0)
+      {
+         if (valid_buffers[slot] && buffers[slot] == buffer && filter())
+            return;
+         buffers[slot] = buffer;
+         valid_buffers[slot] = true;
+      }
+
+      stats.issued++;
+      glBindBuffer(target, buffer);
+   }
+
+   void State::bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+   {
+      Range range = { buffer, offset, size };
+      int slot = index < max_bindings ? indexed_slot(target) : -1;
+      if (slot >= 0)
+      {
+         slot = slot * max_bindings + index;
+         if (valid_ranges[slot] && ranges[slot] == range && filter())
+            return;
+         ranges[slot] = range;
+         valid_ranges[slot] = true;
+      }
+
+      stats.issued++;
+      if (size)
+         glBindBufferRange(target, index, buffer, offset, size);
+      else
+         glBindBufferBase(target, index, buffer);
+
+      // Indexed binds also replace the generic binding of the target.
+      slot = buffer_slot(target);
+      if (slot >= 0)
+      {
+         buffers[slot] = buffer;
+         valid_buffers[slot] = true;
+      }
+   }
+
+   void State::active_texture(unsigned unit)
+   {
+      if (valid_active_unit && active_unit == unit && filter())
+         return;
+
+      stats.issued++;
+      glActiveTexture(GL_TEXTURE0 + unit);
+      active_unit = unit;
+      valid_active_unit = true;
+   }
+
+   void State::bind_texture(unsigned unit, GLenum target, GLuint texture)
+   {
+      int slot = unit < max_units ? texture_slot(target) : -1;
+      if (slot >= 0)
+      {
+         slot += unit * num_texture_targets;
+         if (valid_textures[slot] && textures[slot] == texture && filter())
+            return;
+      }
+
+      active_texture(unit);
+      stats.issued++;
+      glBindTexture(target, texture);
+      if (slot >= 0)
+      {
+         textures[slot] = texture;
+         valid_textures[slot] = true;
+      }
+   }
+
+   void State::bind_sampler(unsigned unit, GLuint sampler)
+   {
+      if (unit < max_units)
+      {
+         if (valid_samplers[unit] && samplers[unit] == sampler && filter())
+            return;
+         samplers[unit] = sampler;
+         valid_samplers[unit] = true;
+      }
+
+      stats.issued++;
+      glBindSampler(unit, sampler);
+   }
+
+   template<typename Bits>
+   static void forget(Bits& valid, const GLuint *ids, GLuint id)
+   {
+      for (size_t i = 0; i < valid.size(); i++)
+         if (ids[i] == id)
+            valid[i] = false;
+   }
+
+   void State::deleted_program(GLuint prog)
+   {
+      if (program == prog)
+         valid_program = false;
+   }
+
+   void State::deleted_vertex_array(GLuint vao)
+   {
+      if (vertex_array == vao)
+         valid_vertex_array = false;
+   }
+
+   void State::deleted_buffer(GLuint buffer)
+   {
+      forget(valid_buffers, buffers, buffer);
+      for (size_t i = 0; i < valid_ranges.size(); i++)
+         if (ranges[i].buffer == buffer)
+            valid_ranges[i] = false;
+   }
+
+   void State::deleted_texture(GLuint texture)
+   {
+      forget(valid_textures, textures, texture);
+   }
+
+   void State::deleted_sampler(GLuint sampler)
+   {
+      forget(valid_samplers, samplers, sampler);
+   }
+}
+
@@ -0,0 +1,97 @@
+#ifndef STATE_HPP__
+#define STATE_HPP__
+
+#include "global.hpp"
+#include <bitset>
+
+namespace GL
+{
+   // Shadows GL binding state so redundant binds never reach the driver.
+   // All GL:: wrappers bind programs, vertex arrays, buffers, textures and
+   // samplers through here. Filtering is compiled in with GL_STATE_CACHE,
+   // without it every call is forwarded, but still counted.
+   //
+   // The frontend may touch state between frames, so the shadow is dropped
+   // at the start of every frame and on context reset.
+   class State
+   {
+      public:
+         static State& get();
+
+         struct Stats
+         {
+            unsigned issued = 0;
+            unsigned elided = 0;
+         };
+
+         void begin_frame();
+         void invalidate();
+
+         // Counts of the last complete frame.
+         const Stats& frame_stats() const { return last_stats; }
+
+         void use_program(GLuint prog);
+         void bind_vertex_array(GLuint vao);
+         void bind_buffer(GLenum target, GLuint buffer);
+         void bind_buffer_range(GLenum target, GLuint index, GLuint buffer,
+               GLintptr offset = 0, GLsizeiptr size = 0); // Size 0 binds the whole buffer.
+         void bind_texture(unsigned unit, GLenum target, GLuint texture);
+         void active_texture(unsigned unit); // For texture updates through the bind point.
+         void bind_sampler(unsigned unit, GLuint sampler);
+
+         // Deleting a bound object resets its bindings to 0 in GL.
+         void deleted_program(GLuint prog);
+         void deleted_vertex_array(GLuint vao);
+         void deleted_buffer(GLuint buffer);
+         void deleted_texture(GLuint texture);
+         void deleted_sampler(GLuint sampler);
+
+      private:
+         State() {}
+
+         struct Range
+         {
+            GLuint buffer;
+            GLintptr offset;
+            GLsizeiptr size;
+
+            bool operator==(const Range& other) const
+            {
+               return buffer == other.buffer && offset == other.offset && size == other.size;
+            }
+         };
+
+         // Shadows are fixed tables indexed by the slots in state.cpp. An entry only
+         // counts while its valid bit is set, so invalidating just clears the bits.
+         // Targets, units and binding points outside the tables are never filtered.
+         static const unsigned num_buffer_targets = 12;
+         static const unsigned num_indexed_targets = 4;
+         static const unsigned num_texture_targets = 5;
+         static const unsigned max_bindings = 16;
+         static const unsigned max_units = 16;
+
+         bool valid_program = false;
+         GLuint program = 0;
+         bool valid_vertex_array = false;
+         GLuint vertex_array = 0;
+         bool valid_active_unit = false;
+         unsigned active_unit = 0;
+         std::bitset<num_buffer_targets> valid_buffers;
+         GLuint buffers[num_buffer_targets] = {};
+         std::bitset<num_indexed_targets * max_bindings> valid_ranges;
+         Range ranges[num_indexed_targets * max_bindings] = {};
+         std::bitset<max_units * num_texture_targets> valid_textures;
+         GLuint textures[max_units * num_texture_targets] = {};
+         std::bitset<max_units> valid_samplers;
+         GLuint samplers[max_units] = {};
+
+         unsigned frame = 0;
+         Stats stats;
+         Stats last_stats;
+
+         bool filter();
+   };
+}
+
+#endif
+
@@ -1,4 +1,6 @@
 #include "texture.hpp"
+#include "thread_pool.hpp"
+#include "state.hpp"
 #include <rpng/rpng.h>
 #include <math.h>
 #include <utility>
@@ -107,12 +109,12 @@ namespace GL
 
    void Sampler::bind(unsigned unit)
    {
-      glBindSampler(unit, id);
+      State::get().bind_sampler(unit, id);
    }
 
    void Sampler::unbind(unsigned unit)
    {
-      glBindSampler(unit, 0);
+      State::get().bind_sampler(unit, 0);
    }
 
    void Sampler::reset()
@@ -129,22 +131,21 @@ namespace GL
    void Sampler::destroyed()
    {
       if (id)
+      {
          glDeleteSamplers(1, &id);
+         State::get().deleted_sampler(id);
+      }
       id = 0;
    }
 
    void Texture::bind(unsigned unit)
    {
-      glActiveTexture(GL_TEXTURE0 + unit);
-      glBindTexture(texture_type, id);
-      glActiveTexture(GL_TEXTURE0);
+      State::get().bind_texture(unit, texture_type, id);
    }
 
    void Texture::unbind(unsigned unit)
    {
-      glActiveTexture(GL_TEXTURE0 + unit);
-      glBindTexture(texture_type, 0);
-      glActiveTexture(GL_TEXTURE0);
+      State::get().bind_texture(unit, texture_type, 0);
    }
 
    void Texture::bind_image(unsigned unit, StorageAccess access, unsigned level, unsigned layer)
@@ -167,9 +168,22 @@ namespace GL
             GL_FALSE, 0, GL_READ_ONLY, GL_R8);
    }
 
+   void Texture::copy_framebuffer(unsigned level, unsigned width, unsigned height)
+   {
+      if (dsa)
+         glCopyTextureSubImage2D(id, level, 0, 0, 0, 0, width, height);
+      else
+      {
+         bind(0);
+         State::get().active_texture(0);
+         glCopyTexSubImage2D(texture_type, level, 0, 0, 0, 0, width, height);
+         unbind(0);
+      }
+   }
+
    void Texture::reset()
    {
-      glGenTextures(1, &id);
+      create_texture();
       if (desc.type != TextureNone)
          setup();
    }
@@ -177,7 +191,10 @@ namespace GL
    void Texture::destroyed()
    {
       if (id)
+      {
          glDeleteTextures(1, &id);
+         State::get().deleted_texture(id);
+      }
       id = 0;
    }
 
@@ -188,11 +205,13 @@ namespace GL
          desc.levels = size_to_miplevels(desc.width, desc.height);
       texture_type = type_to_gl(desc.type);
       res = {};
+      pending.clear();
 
       if (id)
       {
          glDeleteTextures(1, &id);
-         glGenTextures(1, &id);
+         State::get().deleted_texture(id);
+         create_texture();
          setup();
       }
    }
@@ -209,10 +228,8 @@ namespace GL
       }
    }
 
-   void Texture::load_texture_data()
+   void Texture::validate_resource(const Resource& res)
    {
-      data.clear();
-
       switch (res.type)
       {
          case Texture1D:
@@ -236,31 +253,50 @@ namespace GL
          default:
             throw std::logic_error("Invalid texture format!");
       }
+   }
 
-      unsigned index = 0;
-      for (auto& path : res.paths)
-      {
-         uint32_t *raw_data = nullptr;
-         unsigned width = 0;
-         unsigned height = 0;
+   // Runs on the thread pool, must not touch GL.
+   Texture::TextureData Texture::decode_image(const string& path)
+   {
+      uint32_t *raw_data = nullptr;
+      unsigned width = 0;
+      unsigned height = 0;
 
-         auto apath = asset_path(path);
-         if (!rpng_load_image_argb(apath.c_str(), &raw_data, &width, &height))
-            throw std::runtime_error(String::cat("Failed to load texture: ", path.c_str()));
+      if (!rpng_load_image_argb(path.c_str(), &raw_data, &width, &height))
+         throw std::runtime_error(String::cat("Failed to load texture: ", path.c_str()));
 
-         if ((desc.width && width != desc.width) || (desc.height && height != desc.height))
-            throw std::logic_error("Textures are not all of same size!");
+      std::vector<uint8_t> byte_data;
+      byte_data.resize(width * height * sizeof(uint32_t));
+      swizzle(byte_data.data(), raw_data, width * height);
+      free(raw_data);
 
-         desc.width = width;
-         desc.height = height;
+      return { move(byte_data), width, height };
+   }
 
-         std::vector<uint8_t> byte_data;
-         byte_data.resize(width * height * sizeof(uint32_t));
-         swizzle(byte_data.data(), raw_data, width * height);
+   void Texture::load_texture_data()
+   {
+      data.clear();
 
-         data.push_back({move(byte_data), width, height});
-         free(raw_data);
-         index++;
+      // Later context resets decode again since the data is released after upload.
+      if (pending.empty())
+      {
+         for (auto& path : res.paths)
+            data.push_back(decode_image(asset_path(path)));
+      }
+      else
+      {
+         for (auto& image : pending)
+            data.push_back(image.get());
+         pending.clear();
+      }
+
+      for (auto& image : data)
+      {
+         if ((desc.width && image.width != desc.width) || (desc.height && image.height != desc.height))
+            throw std::logic_error("Textures are not all of same size!");
+
+         desc.width = image.width;
+         desc.height = image.height;
       }
 
       if (res.type == Texture2DArray)
@@ -275,7 +311,10 @@ namespace GL
       switch (desc.type)
       {
          case Texture2D:
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, data[0].width, data[0].height, GL_RGBA, GL_UNSIGNED_BYTE, data[0].data.data());
+            if (dsa)
+               glTextureSubImage2D(id, 0, 0, 0, data[0].width, data[0].height, GL_RGBA, GL_UNSIGNED_BYTE, data[0].data.data());
+            else
+               glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, data[0].width, data[0].height, GL_RGBA, GL_UNSIGNED_BYTE, data[0].data.data());
             break;
 
          case Texture2DArray:
@@ -283,7 +322,10 @@ namespace GL
             unsigned i = 0;
             for (auto& slice : data)
             {
-               glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, slice.width, slice.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, slice.data.data());
+               if (dsa)
+                  glTextureSubImage3D(id, 0, 0, 0, i, slice.width, slice.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, slice.data.data());
+               else
+                  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, slice.width, slice.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, slice.data.data());
                i++;
             }
             break;
@@ -291,8 +333,14 @@ namespace GL
 
          case TextureCube:
          {
+            // With DSA, cube maps are addressed as six layers.
             for (unsigned i = 0; i < 6; i++)
-               glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, data[i].width, data[i].height, GL_RGBA, GL_UNSIGNED_BYTE, data[i].data.data());
+            {
+               if (dsa)
+                  glTextureSubImage3D(id, 0, 0, 0, i, data[i].width, data[i].height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data[i].data.data());
+               else
+                  glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, data[i].width, data[i].height, GL_RGBA, GL_UNSIGNED_BYTE, data[i].data.data());
+            }
             break;
          }
 
@@ -302,13 +350,28 @@ namespace GL
 
       data.clear();
       if (res.generate_mipmaps)
-         glGenerateMipmap(texture_type);
+      {
+         if (dsa)
+            glGenerateTextureMipmap(id);
+         else
+            glGenerateMipmap(texture_type);
+      }
    }
 
    void Texture::load_texture(const Resource& res)
    {
+      validate_resource(res);
       this->res = res;
 
+      pending.clear();
+      for (auto& path : res.paths)
+      {
+         auto apath = asset_path(path);
+         pending.push_back(Util::ThreadPool::get().submit([apath] {
+            return decode_image(apath);
+         }));
+      }
+
       desc.type            = res.type;
       desc.levels          = 1;
       desc.internal_format = GL_RGBA8;
@@ -321,7 +384,8 @@ namespace GL
       if (id)
       {
          glDeleteTextures(1, &id);
-         glGenTextures(1, &id);
+         State::get().deleted_texture(id);
+         create_texture();
          setup();
       }
    }
@@ -331,9 +395,29 @@ namespace GL
       return unsigned(floor(log2(max(width, height))) + 1);
    }
 
+   void Texture::create_texture()
+   {
+      // glCreateTextures needs the target up front.
+      if (context_caps().direct_state_access && texture_type != GL_NONE)
+      {
+         glCreateTextures(texture_type, 1, &id);
+         dsa = true;
+      }
+      else
+      {
+         glGenTextures(1, &id);
+         dsa = false;
+      }
+   }
+
    void Texture::setup()
    {
-      bind(0);
+      // Without DSA, uploads below go through the bind point of the active unit.
+      if (!dsa)
+      {
+         bind(0);
+         State::get().active_texture(0);
+      }
 
       if (!res.paths.empty())
          load_texture_data();
@@ -341,24 +425,36 @@ namespace GL
       switch (desc.type)
       {
          case Texture1D:
-            glTexStorage1D(texture_type,
-                  desc.levels, desc.internal_format, desc.width);
+            if (dsa)
+               glTextureStorage1D(id, desc.levels, desc.internal_format, desc.width);
+            else
+               glTexStorage1D(texture_type,
+                     desc.levels, desc.internal_format, desc.width);
             break;
 
          case Texture1DArray:
-            glTexStorage2D(texture_type,
-                  desc.levels, desc.internal_format, desc.width, desc.array_size);
+            if (dsa)
+               glTextureStorage2D(id, desc.levels, desc.internal_format, desc.width, desc.array_size);
+            else
+               glTexStorage2D(texture_type,
+                     desc.levels, desc.internal_format, desc.width, desc.array_size);
             break;
 
          case Texture2D:
          case TextureCube:
-            glTexStorage2D(texture_type,
-                  desc.levels, desc.internal_format, desc.width, desc.height);
+            if (dsa)
+               glTextureStorage2D(id, desc.levels, desc.internal_format, desc.width, desc.height);
+            else
+               glTexStorage2D(texture_type,
+                     desc.levels, desc.internal_format, desc.width, desc.height);
             break;
 
          case Texture2DArray:
-            glTexStorage3D(texture_type,
-                  desc.levels, desc.internal_format, desc.width, desc.height, desc.array_size);
+            if (dsa)
+               glTextureStorage3D(id, desc.levels, desc.internal_format, desc.width, desc.height, desc.array_size);
+            else
+               glTexStorage3D(texture_type,
+                     desc.levels, desc.internal_format, desc.width, desc.height, desc.array_size);
             break;
 
          default:
@@ -368,7 +464,8 @@ namespace GL
       if (!res.paths.empty())
          upload_texture_data();
 
-      unbind(0);
+      if (!dsa)
+         unbind(0);
    }
 
    GLenum Texture::type_to_gl(Type type)
@@ -3,6 +3,7 @@
 
 #include "global.hpp"
 #include <string>
+#include <future>
 
 namespace GL
 {
@@ -101,6 +102,7 @@ namespace GL
          static unsigned size_to_miplevels(unsigned width, unsigned height);
 
          void init(const Desc& desc);
+         // Images start decoding on the thread pool right away, the GL upload happens on context reset.
          void load_texture(const Resource& res);
 
          void bind(unsigned unit);
@@ -109,6 +111,10 @@ namespace GL
          void bind_image(unsigned unit, StorageAccess access, unsigned level = 0, unsigned layer = 0);
          void unbind_image(unsigned unit);
 
+         // Copies the bottom left corner of the read framebuffer into a level.
+         // Depth textures take the depth attachment, anything else the color read buffer.
+         void copy_framebuffer(unsigned level, unsigned width, unsigned height);
+
          void reset() override;
          void destroyed() override;
 
@@ -118,10 +124,12 @@ namespace GL
       private:
          GLuint id = 0;
          GLenum texture_type = 0;
+         bool dsa = false; // Created with glCreateTextures, edited without binding.
 
          Desc desc;
          Resource res;
 
+         void create_texture();
          void setup();
 
          void load_texture_data();
@@ -136,6 +144,12 @@ namespace GL
             unsigned height;
          };
          std::vector<TextureData> data;
+
+         // Decodes submitted by load_texture(), collected by the first setup() after it.
+         std::vector<std::future<TextureData>> pending;
+
+         static void validate_resource(const Resource& res);
+         static TextureData decode_image(const std::string& path);
    };
 }
 
@@ -0,0 +1,60 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace Util
+{
+   ThreadPool& ThreadPool::get()
+   {
+      static ThreadPool pool(max(thread::hardware_concurrency(), 2u));
+      return pool;
+   }
+
+   ThreadPool::ThreadPool(unsigned num_threads)
+   {
+      for (unsigned i = 0; i < num_threads; i++)
+         threads.emplace_back(&ThreadPool::worker, this);
+   }
+
+   ThreadPool::~ThreadPool()
+   {
+      {
+         lock_guard<mutex> holder{lock};
+         shutdown = true;
+      }
+      cond.notify_all();
+
+      for (auto& thread : threads)
+         thread.join();
+   }
+
+   void ThreadPool::push(function<void ()> job)
+   {
+      {
+         lock_guard<mutex> holder{lock};
+         jobs.push(move(job));
+      }
+      cond.notify_one();
+   }
+
+   void ThreadPool::worker()
+   {
+      for (;;)
+      {
+         function<void ()> job;
+         {
+            unique_lock<mutex> holder{lock};
+            cond.wait(holder, [this] { return shutdown || !jobs.empty(); });
+
+            // Drain remaining jobs before exiting so no future is left without a result.
+            if (jobs.empty())
+               return;
+
+            job = move(jobs.front());
+            jobs.pop();
+         }
+         job();
+      }
+   }
+}
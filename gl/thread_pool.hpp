@@ -0,0 +1,51 @@
+#ifndef THREAD_POOL_HPP__
+#define THREAD_POOL_HPP__
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Util
+{
+   // Worker threads for CPU side asset work (file reads, OBJ parsing, PNG decoding).
+   // Jobs must not touch GL, results are handed back to the GL thread through futures.
+   class ThreadPool
+   {
+      public:
+         static ThreadPool& get();
+
+         explicit ThreadPool(unsigned num_threads);
+         ~ThreadPool();
+
+         ThreadPool(const ThreadPool&) = delete;
+         void operator=(const ThreadPool&) = delete;
+
+         // Exceptions thrown by func are rethrown from future::get().
+         template<typename Func>
+         auto submit(Func&& func) -> std::future<decltype(func())>
+         {
+            using Result = decltype(func());
+            auto task = std::make_shared<std::packaged_task<Result ()>>(std::forward<Func>(func));
+            auto future = task->get_future();
+            push([task] { (*task)(); });
+            return future;
+         }
+
+      private:
+         std::vector<std::thread> threads;
+         std::queue<std::function<void ()>> jobs;
+         std::mutex lock;
+         std::condition_variable cond;
+         bool shutdown = false;
+
+         void push(std::function<void ()> job);
+         void worker();
+   };
+}
+
+#endif
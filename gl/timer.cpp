@@ -0,0 +1,76 @@
+#include "timer.hpp"
+
+using namespace std;
+
+namespace GL
+{
+   void GpuTimer::reset()
+   {
+      glGenQueries(latency, queries);
+      for (auto& i : issued)
+         i = false;
+      slot = 0;
+      running = false;
+   }
+
+   void GpuTimer::destroyed()
+   {
+      glDeleteQueries(latency, queries);
+      for (auto& query : queries)
+         query = 0;
+   }
+
+   void GpuTimer::collect()
+   {
+      for (unsigned i = 0; i < latency; i++)
+      {
+         if (!issued[i])
+            continue;
+
+         GLuint available = GL_FALSE;
+         glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+         if (!available)
+            continue;
+
+         GLuint64 ns = 0;
+         glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &ns);
+         total_ms += ns / 1000000.0;
+         total_samples++;
+         issued[i] = false;
+      }
+   }
+
+   void GpuTimer::begin()
+   {
+      collect();
+      if (issued[slot])
+         return;
+
+      glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+      running = true;
+   }
+
+   void GpuTimer::end()
+   {
+      if (!running)
+         return;
+
+      glEndQuery(GL_TIME_ELAPSED);
+      issued[slot] = true;
+      slot = (slot + 1) % latency;
+      running = false;
+   }
+
+   bool GpuTimer::average(double& ms, unsigned& samples)
+   {
+      collect();
+      if (!total_samples)
+         return false;
+
+      ms = total_ms / total_samples;
+      samples = total_samples;
+      total_ms = 0.0;
+      total_samples = 0;
+      return true;
+   }
+}
@@ -0,0 +1,40 @@
+#ifndef TIMER_HPP__
+#define TIMER_HPP__
+
+#include "global.hpp"
+
+namespace GL
+{
+   // Measures GPU time spent between begin() and end() with GL_TIME_ELAPSED queries.
+   // Results are collected frames later, a timer whose queries are all still
+   // in flight skips a measurement rather than stalling the CPU.
+   class GpuTimer : public ContextListener, public ContextResource
+   {
+      public:
+         GpuTimer() { ContextListener::init(); }
+         ~GpuTimer() { deinit(); }
+
+         void reset() override;
+         void destroyed() override;
+
+         void begin();
+         void end();
+
+         // Average of the results collected since the last call, false if there are none.
+         bool average(double& ms, unsigned& samples);
+
+      private:
+         enum { latency = 4 };
+         GLuint queries[latency] = {};
+         bool issued[latency] = {};
+         unsigned slot = 0;
+         bool running = false;
+
+         double total_ms = 0.0;
+         unsigned total_samples = 0;
+
+         void collect();
+   };
+}
+
+#endif
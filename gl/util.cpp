@@ -1,5 +1,13 @@
 #include "util.hpp"
 
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace Log
 {
    static LogFunc logger_cb;
@@ -8,3 +16,76 @@ namespace Log
    LogFunc get_logger() { return logger_cb; }
 }
 
+namespace File
+{
+   bool stamp(const std::string& path, Stamp& stamp)
+   {
+      struct stat st;
+      if (::stat(path.c_str(), &st) < 0)
+         return false;
+
+      stamp.size = st.st_size;
+      stamp.mtime = st.st_mtime;
+      return true;
+   }
+
+   bool MappedFile::open(const std::string& path)
+   {
+      close();
+
+#ifndef _WIN32
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+         return false;
+
+      struct stat st;
+      if (fstat(fd, &st) < 0)
+      {
+         ::close(fd);
+         return false;
+      }
+
+      len = st.st_size;
+      if (len)
+      {
+         void *mem = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (mem != MAP_FAILED)
+         {
+            madvise(mem, len, MADV_SEQUENTIAL);
+            ptr = static_cast<const char*>(mem);
+            mapped = true;
+         }
+      }
+      ::close(fd);
+
+      if (mapped || !len)
+         return true;
+#endif
+
+      // Fallback, read everything into memory.
+      std::ifstream file(path, std::ios::in | std::ios::binary);
+      if (!file.is_open())
+         return false;
+
+      file.seekg(0, std::ios::end);
+      buffer.resize(size_t(file.tellg()));
+      file.seekg(0, std::ios::beg);
+      file.read(buffer.data(), buffer.size());
+
+      ptr = buffer.data();
+      len = buffer.size();
+      return true;
+   }
+
+   void MappedFile::close()
+   {
+#ifndef _WIN32
+      if (mapped)
+         munmap(const_cast<char*>(ptr), len);
+#endif
+      mapped = false;
+      buffer.clear();
+      ptr = nullptr;
+      len = 0;
+   }
+}
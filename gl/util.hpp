@@ -13,6 +13,7 @@
 #include <cstdarg>
 #include <cstring>
 #include <memory>
+#include <cstdint>
 
 namespace Util
 {
@@ -179,6 +180,40 @@ namespace File
       ss << file.rdbuf();
       return ss.str();
    }
+
+   // Size and modification time of a file, used to detect stale caches.
+   struct Stamp
+   {
+      uint64_t size = 0;
+      int64_t mtime = 0;
+
+      bool operator==(const Stamp& other) const { return size == other.size && mtime == other.mtime; }
+      bool operator!=(const Stamp& other) const { return !(*this == other); }
+   };
+   bool stamp(const std::string& path, Stamp& stamp);
+
+   // Read-only view of an entire file. Uses mmap() where available
+   // so large assets can be parsed in-place without copying.
+   class MappedFile
+   {
+      public:
+         MappedFile() = default;
+         ~MappedFile() { close(); }
+         MappedFile(const MappedFile&) = delete;
+         MappedFile& operator=(const MappedFile&) = delete;
+
+         bool open(const std::string& path);
+         void close();
+
+         const char *data() const { return ptr; }
+         size_t size() const { return len; }
+
+      private:
+         const char *ptr = nullptr;
+         size_t len = 0;
+         bool mapped = false;
+         std::vector<char> buffer;
+   };
 }
 
 #endif
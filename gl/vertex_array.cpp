@@ -1,40 +1,88 @@
 #include "vertex_array.hpp"
+#include "state.hpp"
 
 using namespace std;
 
 namespace GL
 {
+   static GLsizei attrib_size(GLint size, GLenum type)
+   {
+      switch (type)
+      {
+         case GL_BYTE:
+         case GL_UNSIGNED_BYTE:
+            return size;
+         case GL_SHORT:
+         case GL_UNSIGNED_SHORT:
+         case GL_HALF_FLOAT:
+            return size * 2;
+         case GL_INT_2_10_10_10_REV:
+         case GL_UNSIGNED_INT_2_10_10_10_REV:
+            return 4;
+         case GL_DOUBLE:
+            return size * 8;
+         default:
+            return size * 4;
+      }
+   }
+
+   // Each array gets its own binding point at its location, the binding
+   // carries the offset so the relative offset stays 0.
+   void VertexArray::setup_direct()
+   {
+      if (elem_buffer)
+         glVertexArrayElementBuffer(vao, elem_buffer->id);
+
+      for (auto& array : arrays)
+      {
+         GLsizei stride = array.stride ? array.stride : attrib_size(array.size, array.type);
+         glVertexArrayVertexBuffer(vao, array.location,
+               vertex_buffers[array.buffer_index]->id, array.offset, stride);
+         glVertexArrayAttribFormat(vao, array.location, array.size, array.type, array.normalized, 0);
+         glVertexArrayAttribBinding(vao, array.location, array.location);
+         glVertexArrayBindingDivisor(vao, array.location, array.divisor);
+         glEnableVertexArrayAttrib(vao, array.location);
+      }
+   }
+
    void VertexArray::setup()
    {
+      if (context_caps().direct_state_access)
+      {
+         setup_direct();
+         return;
+      }
+
       bind();
 
+      // Buffers may come from pools created for other targets, so bind explicitly.
       if (elem_buffer)
-         elem_buffer->bind();
+         elem_buffer->bind(GL_ELEMENT_ARRAY_BUFFER);
 
       for (auto& array : arrays)
       {
-         vertex_buffers[array.buffer_index]->bind();
+         vertex_buffers[array.buffer_index]->bind(GL_ARRAY_BUFFER);
          glEnableVertexAttribArray(array.location);
          glVertexAttribPointer(array.location, array.size, array.type,
                array.normalized, array.stride, reinterpret_cast<const void*>(array.offset));
          glVertexAttribDivisor(array.location, array.divisor);
-         vertex_buffers[array.buffer_index]->unbind();
+         vertex_buffers[array.buffer_index]->unbind(GL_ARRAY_BUFFER);
       }
 
       unbind();
 
       if (elem_buffer)
-         elem_buffer->unbind();
+         elem_buffer->unbind(GL_ELEMENT_ARRAY_BUFFER);
    }
 
    void VertexArray::bind()
    {
-      glBindVertexArray(vao);
+      State::get().bind_vertex_array(vao);
    }
 
    void VertexArray::unbind()
    {
-      glBindVertexArray(0);
+      State::get().bind_vertex_array(0);
    }
 
    void VertexArray::setup(const vector<Array>& arrays, std::vector<Buffer*> vertex_buffers, Buffer *elem_buffer)
@@ -62,10 +110,27 @@ namespace GL
       }
    }
 
+   void VertexArray::setup(const vector<Array>& arrays, const vector<BufferRange>& vertex_buffers,
+         const BufferRange& elem_buffer)
+   {
+      auto offset_arrays = arrays;
+      for (auto& array : offset_arrays)
+         array.offset += vertex_buffers[array.buffer_index].offset;
+
+      vector<Buffer*> buffers;
+      for (auto& range : vertex_buffers)
+         buffers.push_back(range.buffer);
+
+      setup(offset_arrays, move(buffers), elem_buffer.buffer);
+   }
+
    void VertexArray::reset()
    {
       alive = true;
-      glGenVertexArrays(1, &vao);
+      if (context_caps().direct_state_access)
+         glCreateVertexArrays(1, &vao);
+      else
+         glGenVertexArrays(1, &vao);
 
       if (!arrays.empty())
          setup();
@@ -74,6 +139,7 @@ namespace GL
    void VertexArray::destroyed()
    {
       glDeleteVertexArrays(1, &vao);
+      State::get().deleted_vertex_array(vao);
       vao = 0;
    }
 }
@@ -29,6 +29,11 @@ namespace GL
 
          void setup(const std::vector<Array>& arrays, std::vector<Buffer*> vertex_buffers, Buffer *elem_buffer);
 
+         // Range offsets are folded into the array offsets. The element range
+         // offset can't be, draws have to start at elem_buffer.first_element().
+         void setup(const std::vector<Array>& arrays, const std::vector<BufferRange>& vertex_buffers,
+               const BufferRange& elem_buffer = BufferRange());
+
          void bind();
          void unbind();
 
@@ -39,6 +44,7 @@ namespace GL
          std::vector<Buffer*> vertex_buffers;
          Buffer* elem_buffer = nullptr;
          void setup();
+         void setup_direct();
    };
 }
 
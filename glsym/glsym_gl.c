@@ -699,6 +699,7 @@ const struct rglgen_sym_map rglgen_symbol_map[] = {
     SYM(GetProgramBinary),
     SYM(ProgramBinary),
     SYM(ProgramParameteri),
+    SYM(MaxShaderCompilerThreadsKHR),
     SYM(UseProgramStages),
     SYM(ActiveShaderProgram),
     SYM(CreateShaderProgramv),
@@ -859,6 +860,40 @@ const struct rglgen_sym_map rglgen_symbol_map[] = {
     SYM(TexBufferRange),
     SYM(TexStorage2DMultisample),
     SYM(TexStorage3DMultisample),
+    SYM(BufferStorage),
+    SYM(CreateBuffers),
+    SYM(NamedBufferStorage),
+    SYM(NamedBufferData),
+    SYM(NamedBufferSubData),
+    SYM(MapNamedBufferRange),
+    SYM(UnmapNamedBuffer),
+    SYM(ClearNamedBufferSubData),
+    SYM(CreateTextures),
+    SYM(TextureStorage1D),
+    SYM(TextureStorage2D),
+    SYM(TextureStorage3D),
+    SYM(TextureSubImage2D),
+    SYM(CopyTextureSubImage2D),
+    SYM(TextureSubImage3D),
+    SYM(GenerateTextureMipmap),
+    SYM(BindTextureUnit),
+    SYM(CreateVertexArrays),
+    SYM(VertexArrayVertexBuffer),
+    SYM(VertexArrayElementBuffer),
+    SYM(VertexArrayAttribFormat),
+    SYM(VertexArrayAttribBinding),
+    SYM(EnableVertexArrayAttrib),
+    SYM(VertexArrayBindingDivisor),
+    SYM(CreateFramebuffers),
+    SYM(NamedFramebufferTexture),
+    SYM(NamedFramebufferTextureLayer),
+    SYM(NamedFramebufferRenderbuffer),
+    SYM(NamedFramebufferDrawBuffers),
+    SYM(CheckNamedFramebufferStatus),
+    SYM(InvalidateNamedFramebufferData),
+    SYM(BlitNamedFramebuffer),
+    SYM(CreateRenderbuffers),
+    SYM(NamedRenderbufferStorageMultisample),
     SYM(ImageTransformParameteriHP),
     SYM(ImageTransformParameterfHP),
     SYM(ImageTransformParameterivHP),
@@ -1698,6 +1733,7 @@ RGLSYMGLCLEARDEPTHFPROC __rglgen_glClearDepthf;
 RGLSYMGLGETPROGRAMBINARYPROC __rglgen_glGetProgramBinary;
 RGLSYMGLPROGRAMBINARYPROC __rglgen_glProgramBinary;
 RGLSYMGLPROGRAMPARAMETERIPROC __rglgen_glProgramParameteri;
+RGLSYMGLMAXSHADERCOMPILERTHREADSKHRPROC __rglgen_glMaxShaderCompilerThreadsKHR;
 RGLSYMGLUSEPROGRAMSTAGESPROC __rglgen_glUseProgramStages;
 RGLSYMGLACTIVESHADERPROGRAMPROC __rglgen_glActiveShaderProgram;
 RGLSYMGLCREATESHADERPROGRAMVPROC __rglgen_glCreateShaderProgramv;
@@ -1858,6 +1894,40 @@ RGLSYMGLSHADERSTORAGEBLOCKBINDINGPROC __rglgen_glShaderStorageBlockBinding;
 RGLSYMGLTEXBUFFERRANGEPROC __rglgen_glTexBufferRange;
 RGLSYMGLTEXSTORAGE2DMULTISAMPLEPROC __rglgen_glTexStorage2DMultisample;
 RGLSYMGLTEXSTORAGE3DMULTISAMPLEPROC __rglgen_glTexStorage3DMultisample;
+RGLSYMGLBUFFERSTORAGEPROC __rglgen_glBufferStorage;
+RGLSYMGLCREATEBUFFERSPROC __rglgen_glCreateBuffers;
+RGLSYMGLNAMEDBUFFERSTORAGEPROC __rglgen_glNamedBufferStorage;
+RGLSYMGLNAMEDBUFFERDATAPROC __rglgen_glNamedBufferData;
+RGLSYMGLNAMEDBUFFERSUBDATAPROC __rglgen_glNamedBufferSubData;
+RGLSYMGLMAPNAMEDBUFFERRANGEPROC __rglgen_glMapNamedBufferRange;
+RGLSYMGLUNMAPNAMEDBUFFERPROC __rglgen_glUnmapNamedBuffer;
+RGLSYMGLCLEARNAMEDBUFFERSUBDATAPROC __rglgen_glClearNamedBufferSubData;
+RGLSYMGLCREATETEXTURESPROC __rglgen_glCreateTextures;
+RGLSYMGLTEXTURESTORAGE1DPROC __rglgen_glTextureStorage1D;
+RGLSYMGLTEXTURESTORAGE2DPROC __rglgen_glTextureStorage2D;
+RGLSYMGLTEXTURESTORAGE3DPROC __rglgen_glTextureStorage3D;
+RGLSYMGLTEXTURESUBIMAGE2DPROC __rglgen_glTextureSubImage2D;
+RGLSYMGLCOPYTEXTURESUBIMAGE2DPROC __rglgen_glCopyTextureSubImage2D;
+RGLSYMGLTEXTURESUBIMAGE3DPROC __rglgen_glTextureSubImage3D;
+RGLSYMGLGENERATETEXTUREMIPMAPPROC __rglgen_glGenerateTextureMipmap;
+RGLSYMGLBINDTEXTUREUNITPROC __rglgen_glBindTextureUnit;
+RGLSYMGLCREATEVERTEXARRAYSPROC __rglgen_glCreateVertexArrays;
+RGLSYMGLVERTEXARRAYVERTEXBUFFERPROC __rglgen_glVertexArrayVertexBuffer;
+RGLSYMGLVERTEXARRAYELEMENTBUFFERPROC __rglgen_glVertexArrayElementBuffer;
+RGLSYMGLVERTEXARRAYATTRIBFORMATPROC __rglgen_glVertexArrayAttribFormat;
+RGLSYMGLVERTEXARRAYATTRIBBINDINGPROC __rglgen_glVertexArrayAttribBinding;
+RGLSYMGLENABLEVERTEXARRAYATTRIBPROC __rglgen_glEnableVertexArrayAttrib;
+RGLSYMGLVERTEXARRAYBINDINGDIVISORPROC __rglgen_glVertexArrayBindingDivisor;
+RGLSYMGLCREATEFRAMEBUFFERSPROC __rglgen_glCreateFramebuffers;
+RGLSYMGLNAMEDFRAMEBUFFERTEXTUREPROC __rglgen_glNamedFramebufferTexture;
+RGLSYMGLNAMEDFRAMEBUFFERTEXTURELAYERPROC __rglgen_glNamedFramebufferTextureLayer;
+RGLSYMGLNAMEDFRAMEBUFFERRENDERBUFFERPROC __rglgen_glNamedFramebufferRenderbuffer;
+RGLSYMGLNAMEDFRAMEBUFFERDRAWBUFFERSPROC __rglgen_glNamedFramebufferDrawBuffers;
+RGLSYMGLCHECKNAMEDFRAMEBUFFERSTATUSPROC __rglgen_glCheckNamedFramebufferStatus;
+RGLSYMGLINVALIDATENAMEDFRAMEBUFFERDATAPROC __rglgen_glInvalidateNamedFramebufferData;
+RGLSYMGLBLITNAMEDFRAMEBUFFERPROC __rglgen_glBlitNamedFramebuffer;
+RGLSYMGLCREATERENDERBUFFERSPROC __rglgen_glCreateRenderbuffers;
+RGLSYMGLNAMEDRENDERBUFFERSTORAGEMULTISAMPLEPROC __rglgen_glNamedRenderbufferStorageMultisample;
 RGLSYMGLIMAGETRANSFORMPARAMETERIHPPROC __rglgen_glImageTransformParameteriHP;
 RGLSYMGLIMAGETRANSFORMPARAMETERFHPPROC __rglgen_glImageTransformParameterfHP;
 RGLSYMGLIMAGETRANSFORMPARAMETERIVHPPROC __rglgen_glImageTransformParameterivHP;
@@ -718,6 +718,7 @@ typedef void (APIENTRYP RGLSYMGLCLEARDEPTHFPROC) (GLfloat d);
 typedef void (APIENTRYP RGLSYMGLGETPROGRAMBINARYPROC) (GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, GLvoid *binary);
 typedef void (APIENTRYP RGLSYMGLPROGRAMBINARYPROC) (GLuint program, GLenum binaryFormat, const GLvoid *binary, GLsizei length);
 typedef void (APIENTRYP RGLSYMGLPROGRAMPARAMETERIPROC) (GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP RGLSYMGLMAXSHADERCOMPILERTHREADSKHRPROC) (GLuint count);
 typedef void (APIENTRYP RGLSYMGLUSEPROGRAMSTAGESPROC) (GLuint pipeline, GLbitfield stages, GLuint program);
 typedef void (APIENTRYP RGLSYMGLACTIVESHADERPROGRAMPROC) (GLuint pipeline, GLuint program);
 typedef GLuint (APIENTRYP RGLSYMGLCREATESHADERPROGRAMVPROC) (GLenum type, GLsizei count, const GLchar* const *strings);
@@ -878,6 +879,40 @@ typedef void (APIENTRYP RGLSYMGLSHADERSTORAGEBLOCKBINDINGPROC) (GLuint program,
 typedef void (APIENTRYP RGLSYMGLTEXBUFFERRANGEPROC) (GLenum target, GLenum internalformat, GLuint buffer, GLintptr offset, GLsizeiptr size);
 typedef void (APIENTRYP RGLSYMGLTEXSTORAGE2DMULTISAMPLEPROC) (GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height, GLboolean fixedsamplelocations);
 typedef void (APIENTRYP RGLSYMGLTEXSTORAGE3DMULTISAMPLEPROC) (GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth, GLboolean fixedsamplelocations);
+typedef void (APIENTRYP RGLSYMGLBUFFERSTORAGEPROC) (GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void (APIENTRYP RGLSYMGLCREATEBUFFERSPROC) (GLsizei n, GLuint *buffers);
+typedef void (APIENTRYP RGLSYMGLNAMEDBUFFERSTORAGEPROC) (GLuint buffer, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void (APIENTRYP RGLSYMGLNAMEDBUFFERDATAPROC) (GLuint buffer, GLsizeiptr size, const void *data, GLenum usage);
+typedef void (APIENTRYP RGLSYMGLNAMEDBUFFERSUBDATAPROC) (GLuint buffer, GLintptr offset, GLsizeiptr size, const void *data);
+typedef void * (APIENTRYP RGLSYMGLMAPNAMEDBUFFERRANGEPROC) (GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (APIENTRYP RGLSYMGLUNMAPNAMEDBUFFERPROC) (GLuint buffer);
+typedef void (APIENTRYP RGLSYMGLCLEARNAMEDBUFFERSUBDATAPROC) (GLuint buffer, GLenum internalformat, GLintptr offset, GLsizeiptr size, GLenum format, GLenum type, const void *data);
+typedef void (APIENTRYP RGLSYMGLCREATETEXTURESPROC) (GLenum target, GLsizei n, GLuint *textures);
+typedef void (APIENTRYP RGLSYMGLTEXTURESTORAGE1DPROC) (GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width);
+typedef void (APIENTRYP RGLSYMGLTEXTURESTORAGE2DPROC) (GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP RGLSYMGLTEXTURESTORAGE3DPROC) (GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+typedef void (APIENTRYP RGLSYMGLTEXTURESUBIMAGE2DPROC) (GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels);
+typedef void (APIENTRYP RGLSYMGLCOPYTEXTURESUBIMAGE2DPROC) (GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height);
+typedef void (APIENTRYP RGLSYMGLTEXTURESUBIMAGE3DPROC) (GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels);
+typedef void (APIENTRYP RGLSYMGLGENERATETEXTUREMIPMAPPROC) (GLuint texture);
+typedef void (APIENTRYP RGLSYMGLBINDTEXTUREUNITPROC) (GLuint unit, GLuint texture);
+typedef void (APIENTRYP RGLSYMGLCREATEVERTEXARRAYSPROC) (GLsizei n, GLuint *arrays);
+typedef void (APIENTRYP RGLSYMGLVERTEXARRAYVERTEXBUFFERPROC) (GLuint vaobj, GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
+typedef void (APIENTRYP RGLSYMGLVERTEXARRAYELEMENTBUFFERPROC) (GLuint vaobj, GLuint buffer);
+typedef void (APIENTRYP RGLSYMGLVERTEXARRAYATTRIBFORMATPROC) (GLuint vaobj, GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset);
+typedef void (APIENTRYP RGLSYMGLVERTEXARRAYATTRIBBINDINGPROC) (GLuint vaobj, GLuint attribindex, GLuint bindingindex);
+typedef void (APIENTRYP RGLSYMGLENABLEVERTEXARRAYATTRIBPROC) (GLuint vaobj, GLuint index);
+typedef void (APIENTRYP RGLSYMGLVERTEXARRAYBINDINGDIVISORPROC) (GLuint vaobj, GLuint bindingindex, GLuint divisor);
+typedef void (APIENTRYP RGLSYMGLCREATEFRAMEBUFFERSPROC) (GLsizei n, GLuint *framebuffers);
+typedef void (APIENTRYP RGLSYMGLNAMEDFRAMEBUFFERTEXTUREPROC) (GLuint framebuffer, GLenum attachment, GLuint texture, GLint level);
+typedef void (APIENTRYP RGLSYMGLNAMEDFRAMEBUFFERTEXTURELAYERPROC) (GLuint framebuffer, GLenum attachment, GLuint texture, GLint level, GLint layer);
+typedef void (APIENTRYP RGLSYMGLNAMEDFRAMEBUFFERRENDERBUFFERPROC) (GLuint framebuffer, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer);
+typedef void (APIENTRYP RGLSYMGLNAMEDFRAMEBUFFERDRAWBUFFERSPROC) (GLuint framebuffer, GLsizei n, const GLenum *bufs);
+typedef GLenum (APIENTRYP RGLSYMGLCHECKNAMEDFRAMEBUFFERSTATUSPROC) (GLuint framebuffer, GLenum target);
+typedef void (APIENTRYP RGLSYMGLINVALIDATENAMEDFRAMEBUFFERDATAPROC) (GLuint framebuffer, GLsizei numAttachments, const GLenum *attachments);
+typedef void (APIENTRYP RGLSYMGLBLITNAMEDFRAMEBUFFERPROC) (GLuint readFramebuffer, GLuint drawFramebuffer, GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter);
+typedef void (APIENTRYP RGLSYMGLCREATERENDERBUFFERSPROC) (GLsizei n, GLuint *renderbuffers);
+typedef void (APIENTRYP RGLSYMGLNAMEDRENDERBUFFERSTORAGEMULTISAMPLEPROC) (GLuint renderbuffer, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height);
 typedef void (APIENTRYP RGLSYMGLIMAGETRANSFORMPARAMETERIHPPROC) (GLenum target, GLenum pname, GLint param);
 typedef void (APIENTRYP RGLSYMGLIMAGETRANSFORMPARAMETERFHPPROC) (GLenum target, GLenum pname, GLfloat param);
 typedef void (APIENTRYP RGLSYMGLIMAGETRANSFORMPARAMETERIVHPPROC) (GLenum target, GLenum pname, const GLint *params);
@@ -1715,6 +1750,7 @@ typedef GLbitfield (APIENTRYP RGLSYMGLQUERYMATRIXXOESPROC) (GLfixed *mantissa, G
 #define glGetProgramBinary __rglgen_glGetProgramBinary
 #define glProgramBinary __rglgen_glProgramBinary
 #define glProgramParameteri __rglgen_glProgramParameteri
+#define glMaxShaderCompilerThreadsKHR __rglgen_glMaxShaderCompilerThreadsKHR
 #define glUseProgramStages __rglgen_glUseProgramStages
 #define glActiveShaderProgram __rglgen_glActiveShaderProgram
 #define glCreateShaderProgramv __rglgen_glCreateShaderProgramv
@@ -1875,6 +1911,40 @@ typedef GLbitfield (APIENTRYP RGLSYMGLQUERYMATRIXXOESPROC) (GLfixed *mantissa, G
 #define glTexBufferRange __rglgen_glTexBufferRange
 #define glTexStorage2DMultisample __rglgen_glTexStorage2DMultisample
 #define glTexStorage3DMultisample __rglgen_glTexStorage3DMultisample
+#define glBufferStorage __rglgen_glBufferStorage
+#define glCreateBuffers __rglgen_glCreateBuffers
+#define glNamedBufferStorage __rglgen_glNamedBufferStorage
+#define glNamedBufferData __rglgen_glNamedBufferData
+#define glNamedBufferSubData __rglgen_glNamedBufferSubData
+#define glMapNamedBufferRange __rglgen_glMapNamedBufferRange
+#define glUnmapNamedBuffer __rglgen_glUnmapNamedBuffer
+#define glClearNamedBufferSubData __rglgen_glClearNamedBufferSubData
+#define glCreateTextures __rglgen_glCreateTextures
+#define glTextureStorage1D __rglgen_glTextureStorage1D
+#define glTextureStorage2D __rglgen_glTextureStorage2D
+#define glTextureStorage3D __rglgen_glTextureStorage3D
+#define glTextureSubImage2D __rglgen_glTextureSubImage2D
+#define glCopyTextureSubImage2D __rglgen_glCopyTextureSubImage2D
+#define glTextureSubImage3D __rglgen_glTextureSubImage3D
+#define glGenerateTextureMipmap __rglgen_glGenerateTextureMipmap
+#define glBindTextureUnit __rglgen_glBindTextureUnit
+#define glCreateVertexArrays __rglgen_glCreateVertexArrays
+#define glVertexArrayVertexBuffer __rglgen_glVertexArrayVertexBuffer
+#define glVertexArrayElementBuffer __rglgen_glVertexArrayElementBuffer
+#define glVertexArrayAttribFormat __rglgen_glVertexArrayAttribFormat
+#define glVertexArrayAttribBinding __rglgen_glVertexArrayAttribBinding
+#define glEnableVertexArrayAttrib __rglgen_glEnableVertexArrayAttrib
+#define glVertexArrayBindingDivisor __rglgen_glVertexArrayBindingDivisor
+#define glCreateFramebuffers __rglgen_glCreateFramebuffers
+#define glNamedFramebufferTexture __rglgen_glNamedFramebufferTexture
+#define glNamedFramebufferTextureLayer __rglgen_glNamedFramebufferTextureLayer
+#define glNamedFramebufferRenderbuffer __rglgen_glNamedFramebufferRenderbuffer
+#define glNamedFramebufferDrawBuffers __rglgen_glNamedFramebufferDrawBuffers
+#define glCheckNamedFramebufferStatus __rglgen_glCheckNamedFramebufferStatus
+#define glInvalidateNamedFramebufferData __rglgen_glInvalidateNamedFramebufferData
+#define glBlitNamedFramebuffer __rglgen_glBlitNamedFramebuffer
+#define glCreateRenderbuffers __rglgen_glCreateRenderbuffers
+#define glNamedRenderbufferStorageMultisample __rglgen_glNamedRenderbufferStorageMultisample
 #define glImageTransformParameteriHP __rglgen_glImageTransformParameteriHP
 #define glImageTransformParameterfHP __rglgen_glImageTransformParameterfHP
 #define glImageTransformParameterivHP __rglgen_glImageTransformParameterivHP
@@ -2712,6 +2782,7 @@ extern RGLSYMGLCLEARDEPTHFPROC __rglgen_glClearDepthf;
 extern RGLSYMGLGETPROGRAMBINARYPROC __rglgen_glGetProgramBinary;
 extern RGLSYMGLPROGRAMBINARYPROC __rglgen_glProgramBinary;
 extern RGLSYMGLPROGRAMPARAMETERIPROC __rglgen_glProgramParameteri;
+extern RGLSYMGLMAXSHADERCOMPILERTHREADSKHRPROC __rglgen_glMaxShaderCompilerThreadsKHR;
 extern RGLSYMGLUSEPROGRAMSTAGESPROC __rglgen_glUseProgramStages;
 extern RGLSYMGLACTIVESHADERPROGRAMPROC __rglgen_glActiveShaderProgram;
 extern RGLSYMGLCREATESHADERPROGRAMVPROC __rglgen_glCreateShaderProgramv;
@@ -2872,6 +2943,40 @@ extern RGLSYMGLSHADERSTORAGEBLOCKBINDINGPROC __rglgen_glShaderStorageBlockBindin
 extern RGLSYMGLTEXBUFFERRANGEPROC __rglgen_glTexBufferRange;
 extern RGLSYMGLTEXSTORAGE2DMULTISAMPLEPROC __rglgen_glTexStorage2DMultisample;
 extern RGLSYMGLTEXSTORAGE3DMULTISAMPLEPROC __rglgen_glTexStorage3DMultisample;
+extern RGLSYMGLBUFFERSTORAGEPROC __rglgen_glBufferStorage;
+extern RGLSYMGLCREATEBUFFERSPROC __rglgen_glCreateBuffers;
+extern RGLSYMGLNAMEDBUFFERSTORAGEPROC __rglgen_glNamedBufferStorage;
+extern RGLSYMGLNAMEDBUFFERDATAPROC __rglgen_glNamedBufferData;
+extern RGLSYMGLNAMEDBUFFERSUBDATAPROC __rglgen_glNamedBufferSubData;
+extern RGLSYMGLMAPNAMEDBUFFERRANGEPROC __rglgen_glMapNamedBufferRange;
+extern RGLSYMGLUNMAPNAMEDBUFFERPROC __rglgen_glUnmapNamedBuffer;
+extern RGLSYMGLCLEARNAMEDBUFFERSUBDATAPROC __rglgen_glClearNamedBufferSubData;
+extern RGLSYMGLCREATETEXTURESPROC __rglgen_glCreateTextures;
+extern RGLSYMGLTEXTURESTORAGE1DPROC __rglgen_glTextureStorage1D;
+extern RGLSYMGLTEXTURESTORAGE2DPROC __rglgen_glTextureStorage2D;
+extern RGLSYMGLTEXTURESTORAGE3DPROC __rglgen_glTextureStorage3D;
+extern RGLSYMGLTEXTURESUBIMAGE2DPROC __rglgen_glTextureSubImage2D;
+extern RGLSYMGLCOPYTEXTURESUBIMAGE2DPROC __rglgen_glCopyTextureSubImage2D;
+extern RGLSYMGLTEXTURESUBIMAGE3DPROC __rglgen_glTextureSubImage3D;
+extern RGLSYMGLGENERATETEXTUREMIPMAPPROC __rglgen_glGenerateTextureMipmap;
+extern RGLSYMGLBINDTEXTUREUNITPROC __rglgen_glBindTextureUnit;
+extern RGLSYMGLCREATEVERTEXARRAYSPROC __rglgen_glCreateVertexArrays;
+extern RGLSYMGLVERTEXARRAYVERTEXBUFFERPROC __rglgen_glVertexArrayVertexBuffer;
+extern RGLSYMGLVERTEXARRAYELEMENTBUFFERPROC __rglgen_glVertexArrayElementBuffer;
+extern RGLSYMGLVERTEXARRAYATTRIBFORMATPROC __rglgen_glVertexArrayAttribFormat;
+extern RGLSYMGLVERTEXARRAYATTRIBBINDINGPROC __rglgen_glVertexArrayAttribBinding;
+extern RGLSYMGLENABLEVERTEXARRAYATTRIBPROC __rglgen_glEnableVertexArrayAttrib;
+extern RGLSYMGLVERTEXARRAYBINDINGDIVISORPROC __rglgen_glVertexArrayBindingDivisor;
+extern RGLSYMGLCREATEFRAMEBUFFERSPROC __rglgen_glCreateFramebuffers;
+extern RGLSYMGLNAMEDFRAMEBUFFERTEXTUREPROC __rglgen_glNamedFramebufferTexture;
+extern RGLSYMGLNAMEDFRAMEBUFFERTEXTURELAYERPROC __rglgen_glNamedFramebufferTextureLayer;
+extern RGLSYMGLNAMEDFRAMEBUFFERRENDERBUFFERPROC __rglgen_glNamedFramebufferRenderbuffer;
+extern RGLSYMGLNAMEDFRAMEBUFFERDRAWBUFFERSPROC __rglgen_glNamedFramebufferDrawBuffers;
+extern RGLSYMGLCHECKNAMEDFRAMEBUFFERSTATUSPROC __rglgen_glCheckNamedFramebufferStatus;
+extern RGLSYMGLINVALIDATENAMEDFRAMEBUFFERDATAPROC __rglgen_glInvalidateNamedFramebufferData;
+extern RGLSYMGLBLITNAMEDFRAMEBUFFERPROC __rglgen_glBlitNamedFramebuffer;
+extern RGLSYMGLCREATERENDERBUFFERSPROC __rglgen_glCreateRenderbuffers;
+extern RGLSYMGLNAMEDRENDERBUFFERSTORAGEMULTISAMPLEPROC __rglgen_glNamedRenderbufferStorageMultisample;
 extern RGLSYMGLIMAGETRANSFORMPARAMETERIHPPROC __rglgen_glImageTransformParameteriHP;
 extern RGLSYMGLIMAGETRANSFORMPARAMETERFHPPROC __rglgen_glImageTransformParameterfHP;
 extern RGLSYMGLIMAGETRANSFORMPARAMETERIVHPPROC __rglgen_glImageTransformParameterivHP;
@@ -2,6 +2,7 @@
 #include "util.hpp"
 #include "global.hpp"
 #include "framebuffer.hpp"
+#include "state.hpp"
 #include <cstring>
 
 using namespace std;
@@ -225,6 +226,7 @@ void retro_run(void)
    if (!use_frame_time_cb)
       frame_delta = 1.0f / 60.0f;
 
+   State::get().begin_frame();
    app->run(frame_delta, state);
 
    if (multisample)
@@ -0,0 +1,81 @@
+// Times load_meshes_obj() on an OBJ file, bypassing the mesh cache.
+//
+//    make -f Makefile.libretro objbench
+//    ./objbench path/to/file.obj [runs] [dump]
+//
+// The path is relative to the working directory. Prints the fastest and the
+// median run. With a dump path, the parsed vertex and index data are written
+// out, so the output of two builds can be compared with cmp.
+
+#include <gl/mesh.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdarg>
+
+using namespace std;
+using namespace GL;
+
+static void logger(const char *fmt, va_list va)
+{
+   vfprintf(stderr, fmt, va);
+   fputc('\n', stderr);
+}
+
+int main(int argc, char **argv)
+{
+   if (argc < 2)
+   {
+      fprintf(stderr, "Usage: %s file.obj [runs] [dump]\n", argv[0]);
+      return 1;
+   }
+
+   unsigned runs = argc > 2 ? max(atoi(argv[2]), 1) : 5;
+   Log::set_logger(logger);
+   ContextManager::get().set_dir(".");
+
+   vector<double> times;
+   vector<Mesh> meshes;
+   try
+   {
+      for (unsigned i = 0; i < runs; i++)
+      {
+         auto start_time = chrono::steady_clock::now();
+         meshes = load_meshes_obj(argv[1], false);
+         times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count());
+      }
+   }
+   catch (const exception& e)
+   {
+      fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+
+   size_t vertices = 0, indices = 0;
+   for (auto& mesh : meshes)
+   {
+      vertices += mesh.vbo.size();
+      indices += mesh.ibo.size();
+   }
+
+   sort(begin(times), end(times));
+   printf("%s: %zu meshes, %zu floats, %zu indices.\n", argv[1], meshes.size(), vertices, indices);
+   printf("%u runs: best %.1f ms, median %.1f ms.\n", runs, times.front(), times[times.size() / 2]);
+
+   if (argc > 3)
+   {
+      FILE *file = fopen(argv[3], "wb");
+      if (!file)
+      {
+         fprintf(stderr, "Failed to open %s.\n", argv[3]);
+         return 1;
+      }
+      for (auto& mesh : meshes)
+      {
+         fwrite(mesh.vbo.data(), sizeof(mesh.vbo[0]), mesh.vbo.size(), file);
+         fwrite(mesh.ibo.data(), sizeof(mesh.ibo[0]), mesh.ibo.size(), file);
+      }
+      fclose(file);
+   }
+}